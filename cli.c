@@ -18,6 +18,7 @@
   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#include <glob.h>
 #include <unistd.h>
 #include <stdio.h> 
 #include <stdlib.h>
@@ -25,8 +26,14 @@
 
 #include <sys/stat.h>
 
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
 #include "bool.h"
 #include "pgn2web.h"
+#include "pool.h"
 
 /* default installation path */
 #ifdef DEBUG
@@ -37,7 +44,49 @@
 #endif
 
 char usage[] = "usage: pgn2web\n"
-               "       pgn2web [-c yes|no] [-p <pieces>] [-s frameset|linked|individual] pgn-filename html-filename\n";
+	       "       pgn2web [-a yes|no] [-c yes|no] [-d yes|no] [-g embedded|shared]\n"
+	       "               [-i yes|no] [-j <jobs>] [-p <pieces>]\n"
+	       "               [-s frameset|linked|individual] [-u yes|no]\n"
+	       "               [-z no|gzip|brotli|both] [--watch]\n"
+	       "               pgn-filename html-filename\n"
+	       "       pgn2web [options] -b batch-filename\n";
+
+/* how long a watched pgn must be left alone before it is converted (milliseconds) */
+#define SETTLE_TIME 250
+
+/* the directory holding a watched pgn, and the pgn's name within it */
+typedef struct {
+  int fd;
+  char *name;
+} WATCH;
+
+/* a pgn file of a batch and where its pages go */
+typedef struct {
+  struct batch *batch;
+  char *pgn_filename;
+  char *html_filename;
+  P2W_ERROR error;
+} BATCH_JOB;
+
+/* the pgn files of a batch, and a converter for each worker */
+typedef struct batch {
+  BATCH_JOB *jobs;
+  int count;
+  int size;
+
+  CONVERTER **converters;
+  int workers;
+} BATCH;
+
+/* function prototypes */
+void add_to_batch(BATCH *batch, const char *pgn_filename, const char *html_filename);
+int compare_directories(const void *a, const void *b);
+int convert_batch(const char *batch_filename, bool credit, const char *pieces, STRUCTURE layout, int options, int jobs);
+void convert_batch_task(void *argument, int worker);
+void free_batch(BATCH *batch);
+bool read_batch(const char *batch_filename, BATCH *batch);
+bool start_watch(WATCH *watch, const char *pgn_filename);
+bool wait_for_change(void *context);
 
 /* main function */
 int main(int argc, char *argv[])
@@ -45,11 +94,22 @@ int main(int argc, char *argv[])
   bool valid = true;
   bool in_options = true;
   int arg;
+  bool append_set = false;
+  int batch_filename = 0;
   bool credit_set = false;
+  bool shard_set = false;
+  bool list_set = false;
+  bool index_set = false;
   bool layout_set = false;
+  bool update_set = false;
+  bool watch_set = false;
+  bool compress_set = false;
+  WATCH watch;
   int pgn_filename = 0;
   int html_filename = 0;
   int pieces = 0;
+  int jobs = 0;
+  P2W_ERROR error;
 
   char *path;
   struct stat stat_buf;
@@ -57,6 +117,7 @@ int main(int argc, char *argv[])
   /* default options */
   bool credit = true;
   STRUCTURE layout = FRAMESET;
+  int options = SIDECAR_INDEX;
 
   /* if no arguments provided then launch gui */
   if(argc == 1) {
@@ -67,8 +128,40 @@ int main(int argc, char *argv[])
   arg = 1;
   while(arg < argc) {
     
-    /* check for option and process it, else assume filenames */
-    if(in_options && argv[arg][0] == '-') {
+    /* check for option and process it, else assume filenames ("-" alone is standard input) */
+    if(in_options && argv[arg][0] == '-' && argv[arg][1] != '\0') {
+
+      if(!append_set && !strcmp("-a", argv[arg])) {
+
+	if(!strcmp("yes", argv[arg + 1])) {
+	  options |= APPEND;
+	  append_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	if(!strcmp("no", argv[arg + 1])) {
+	  append_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	valid = false;
+	break;
+      }
+
+      if(!batch_filename && !strcmp("-b", argv[arg])) {
+
+	/* convert the pgn files listed in a batch file */
+	if(argv[arg + 1]) {
+	  batch_filename = arg + 1;
+	  arg += 2;
+	  continue;
+	}
+
+	valid = false;
+	break;
+      }
 
       if(!credit_set && !strcmp("-c", argv[arg])) {
 	
@@ -90,6 +183,77 @@ int main(int argc, char *argv[])
 	break;
       }
 
+      if(!shard_set && !strcmp("-d", argv[arg])) {
+
+	if(!strcmp("yes", argv[arg + 1])) {
+	  options |= SHARDED_PAGES;
+	  shard_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	if(!strcmp("no", argv[arg + 1])) {
+	  shard_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	valid = false;
+	break;
+      }
+
+      if(!list_set && !strcmp("-g", argv[arg])) {
+
+	if(!strcmp("embedded", argv[arg + 1])) {
+	  list_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	if(!strcmp("shared", argv[arg + 1])) {
+	  options |= SHARED_GAME_LIST;
+	  list_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	valid = false;
+	break;
+      }
+
+      if(!index_set && !strcmp("-i", argv[arg])) {
+
+	if(!strcmp("yes", argv[arg + 1])) {
+	  index_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	if(!strcmp("no", argv[arg + 1])) {
+	  options &= ~SIDECAR_INDEX;
+	  index_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	valid = false;
+	break;
+      }
+
+      if(!jobs && !strcmp("-j", argv[arg])) {
+
+	/* number of games to convert at once */
+	jobs = atoi(argv[arg + 1]);
+
+	if(jobs > 0) {
+	  arg += 2;
+	  continue;
+	}
+
+	valid = false;
+	break;
+      }
+
       if(!pieces && !strcmp("-p", argv[arg])) {
 
 	/* check the piece set is valid */
@@ -139,6 +303,66 @@ int main(int argc, char *argv[])
 	break;
       }
 
+      if(!watch_set && !strcmp("--watch", argv[arg])) {
+	/* stay resident, updating the pages whenever the pgn changes */
+	options |= INCREMENTAL | APPEND;
+	watch_set = true;
+	arg++;
+	continue;
+      }
+
+      if(!update_set && !strcmp("-u", argv[arg])) {
+
+	if(!strcmp("yes", argv[arg + 1])) {
+	  options |= INCREMENTAL;
+	  update_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	if(!strcmp("no", argv[arg + 1])) {
+	  update_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	valid = false;
+	break;
+      }
+
+      if(!compress_set && !strcmp("-z", argv[arg])) {
+
+	if(!strcmp("no", argv[arg + 1])) {
+	  compress_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	if(!strcmp("gzip", argv[arg + 1])) {
+	  options |= GZIP_PAGES;
+	  compress_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	if(!strcmp("brotli", argv[arg + 1])) {
+	  options |= BROTLI_PAGES;
+	  compress_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	if(!strcmp("both", argv[arg + 1])) {
+	  options |= GZIP_PAGES | BROTLI_PAGES;
+	  compress_set = true;
+	  arg += 2;
+	  continue;
+	}
+
+	valid = false;
+	break;
+      }
+
       /* invalid option as there is no match */
       valid = false;
       break;
@@ -149,7 +373,7 @@ int main(int argc, char *argv[])
       in_options = false;
 
       /* test for an option in the wrong place */
-      if(argv[arg][0] == '-') {
+      if(argv[arg][0] == '-' && argv[arg][1] != '\0') {
 	valid = false;
 	break;
       }
@@ -172,18 +396,358 @@ int main(int argc, char *argv[])
     arg++;
   }
 
-  /* make sure that we have both filenames */
-  if(!pgn_filename || !html_filename) {
+  /* make sure that we have both filenames, or a batch file instead */
+  if(batch_filename ? (pgn_filename || watch_set) : (!pgn_filename || !html_filename)) {
+    valid = false;
+  }
+
+  /* standard input can't be watched */
+  if(watch_set && pgn_filename && !strcmp(argv[pgn_filename], "-")) {
     valid = false;
   }
 
   /* either execute or print error message */
-  if(valid) {
-    return pgn2web(INSTALL_PATH, argv[pgn_filename], argv[html_filename], credit,
-		   pieces ? argv[pieces] : "merida", layout, NULL, NULL);
+  if(valid && batch_filename) {
+    return convert_batch(argv[batch_filename], credit, pieces ? argv[pieces] : "merida", layout, options, jobs ? jobs : 1);
+  }
+  else if(valid && watch_set) {
+    if(!start_watch(&watch, argv[pgn_filename])) {
+      return 1;
+    }
+    error = pgn2web_watch(INSTALL_PATH, argv[pgn_filename], argv[html_filename], credit,
+			  pieces ? argv[pieces] : "merida", layout, options, jobs ? jobs : 1, NULL, NULL,
+			  wait_for_change, &watch);
+  }
+  else if(valid) {
+    error = pgn2web(INSTALL_PATH, argv[pgn_filename], argv[html_filename], credit,
+		    pieces ? argv[pieces] : "merida", layout, options, jobs ? jobs : 1, NULL, NULL);
   }
   else {
-    printf(usage);
+    fputs(usage, stdout);
+    return 1;
+  }
+
+  if(error != P2W_OK) {
+    fprintf(stderr, "pgn2web: %s\n", pgn2web_error(error));
+    return P2W_WARNING(error) ? 0 : 1;
+  }
+
+  return 0;
+}
+
+/* adds a pgn file and where its pages go to the batch, enlarging it as required */
+void add_to_batch(BATCH *batch, const char *pgn_filename, const char *html_filename)
+{
+  BATCH_JOB *job;
+
+  if(batch->count == batch->size) {
+    batch->size = batch->size ? batch->size * 2 : 64;
+    batch->jobs = (BATCH_JOB*)realloc((void*)batch->jobs, batch->size * sizeof(BATCH_JOB));
+  }
+
+  job = &batch->jobs[batch->count++];
+  job->batch = batch;
+  job->error = P2W_OK;
+
+  job->pgn_filename = (char*)calloc(strlen(pgn_filename) + 1, sizeof(char));
+  strcpy(job->pgn_filename, pgn_filename);
+  job->html_filename = (char*)calloc(strlen(html_filename) + 1, sizeof(char));
+  strcpy(job->html_filename, html_filename);
+}
+
+/* orders batch jobs by the directory their pages go to */
+int compare_directories(const void *a, const void *b)
+{
+  const BATCH_JOB *job_a = *(const BATCH_JOB**)a;
+  const BATCH_JOB *job_b = *(const BATCH_JOB**)b;
+  const char *end_a = strrchr(job_a->html_filename, '/');
+  const char *end_b = strrchr(job_b->html_filename, '/');
+  size_t length_a = end_a ? (size_t)(end_a - job_a->html_filename) : 0;
+  size_t length_b = end_b ? (size_t)(end_b - job_b->html_filename) : 0;
+  int order;
+
+  order = memcmp(job_a->html_filename, job_b->html_filename, length_a < length_b ? length_a : length_b);
+
+  if(order == 0 && length_a != length_b) {
+    order = (length_a < length_b) ? -1 : 1;
+  }
+
+  return order;
+}
+
+/* converts every pgn file listed in the batch file, each worker thread has its own
+   converter so the templates are only compiled once per thread. returns the exit status */
+int convert_batch(const char *batch_filename, bool credit, const char *pieces, STRUCTURE layout, int options, int jobs)
+{
+  BATCH batch;
+  BATCH_JOB **sorted;
+  POOL *pool;
+  P2W_ERROR error;
+  int job, worker, failed;
+
+  memset(&batch, 0, sizeof(BATCH));
+
+  if(!read_batch(batch_filename, &batch)) {
+    free_batch(&batch);
     return 1;
   }
+
+  /* the files are converted one per thread */
+  pool = (jobs > 1) ? pool_create(jobs) : NULL;
+  batch.workers = pool ? pool_threads(pool) : 1;
+  batch.converters = (CONVERTER**)calloc(batch.workers, sizeof(CONVERTER*));
+
+  for(worker = 0; worker < batch.workers; worker++) {
+    if((error = pgn2web_create(&batch.converters[worker], INSTALL_PATH, credit, pieces, layout, options | NO_IMAGE_COPY, 1)) != P2W_OK) {
+      fprintf(stderr, "pgn2web: %s\n", pgn2web_error(error));
+      batch.workers = worker;
+      if(pool) {
+	pool_destroy(pool);
+      }
+      free_batch(&batch);
+      return 1;
+    }
+  }
+
+  /* copy the images to each output directory up front, once, rather than having the workers
+     check them for every file. the files whose images couldn't be copied aren't converted */
+  sorted = (BATCH_JOB**)calloc(batch.count ? batch.count : 1, sizeof(BATCH_JOB*));
+  for(job = 0; job < batch.count; job++) {
+    sorted[job] = &batch.jobs[job];
+  }
+
+  qsort((void*)sorted, batch.count, sizeof(BATCH_JOB*), compare_directories);
+
+  for(job = 0; job < batch.count; job++) {
+    if(job == 0 || compare_directories(&sorted[job - 1], &sorted[job])) {
+      error = pgn2web_copy_images(batch.converters[0], sorted[job]->html_filename);
+    }
+    sorted[job]->error = error;
+  }
+
+  free((void*)sorted);
+
+  /* convert the files */
+  for(job = 0; job < batch.count; job++) {
+    if(batch.jobs[job].error != P2W_OK) {
+      continue;
+    }
+
+    if(pool) {
+      pool_submit(pool, convert_batch_task, &batch.jobs[job]);
+    }
+    else {
+      convert_batch_task(&batch.jobs[job], 0);
+    }
+  }
+
+  if(pool) {
+    pool_destroy(pool);
+  }
+
+  /* report what failed, then a summary */
+  failed = 0;
+  for(job = 0; job < batch.count; job++) {
+    if(batch.jobs[job].error != P2W_OK) {
+      fprintf(stderr, "pgn2web: %s: %s\n", batch.jobs[job].pgn_filename, pgn2web_error(batch.jobs[job].error));
+      if(!P2W_WARNING(batch.jobs[job].error)) {
+	failed++;
+      }
+    }
+  }
+
+  printf("pgn2web: converted %d of %d pgn files\n", batch.count - failed, batch.count);
+
+  free_batch(&batch);
+
+  return failed ? 1 : 0;
+}
+
+/* converts one pgn file of a batch with the worker's converter */
+void convert_batch_task(void *argument, int worker)
+{
+  BATCH_JOB *job = (BATCH_JOB*)argument;
+
+  CONVERTER *converter = job->batch->converters[worker];
+
+  if((job->error = pgn2web_convert(converter, job->pgn_filename, job->html_filename, NULL, NULL)) == P2W_OK) {
+    job->error = pgn2web_warning(converter);
+  }
+}
+
+/* frees the jobs and converters of a batch */
+void free_batch(BATCH *batch)
+{
+  int job, worker;
+
+  for(job = 0; job < batch->count; job++) {
+    free((void*)batch->jobs[job].pgn_filename);
+    free((void*)batch->jobs[job].html_filename);
+  }
+
+  for(worker = 0; worker < batch->workers; worker++) {
+    pgn2web_destroy(batch->converters[worker]);
+  }
+
+  free((void*)batch->jobs);
+  free((void*)batch->converters);
+}
+
+/* reads a batch file, each line holds a pgn filename and an html filename separated by a tab.
+   when the html filename ends in a '/' the pgn filename may be a pattern (as in the shell),
+   and each pgn file matching it gets pages of the same name (but .html) in that directory */
+bool read_batch(const char *batch_filename, BATCH *batch)
+{
+  FILE *file;
+  char line[4096];
+  char *tab, *end, *name, *extension;
+  char *html_filename;
+  glob_t matches;
+  size_t match;
+  int line_number = 0;
+  bool valid = true;
+
+  if((file = fopen(batch_filename, "r")) == NULL) {
+    perror("Unable to open batch file");
+    return false;
+  }
+
+  while(valid && fgets(line, sizeof(line), file)) {
+    line_number++;
+
+    /* strip the line ending, then skip blank lines and comments */
+    end = line + strcspn(line, "\r\n");
+    *end = '\0';
+
+    if(*line == '\0' || *line == '#') {
+      continue;
+    }
+
+    if((tab = strchr(line, '\t')) == NULL || tab == line || tab[1] == '\0') {
+      fprintf(stderr, "pgn2web: %s line %d: expected a pgn and an html filename separated by a tab\n",
+	      batch_filename, line_number);
+      valid = false;
+      break;
+    }
+
+    *tab = '\0';
+
+    /* a single pgn file */
+    if(*(end - 1) != '/') {
+      add_to_batch(batch, line, tab + 1);
+      continue;
+    }
+
+    /* every pgn file matching the pattern, into the directory */
+    if(glob(line, 0, NULL, &matches)) {
+      fprintf(stderr, "pgn2web: %s line %d: no pgn files match %s\n", batch_filename, line_number, line);
+      continue;
+    }
+
+    for(match = 0; match < matches.gl_pathc; match++) {
+      name = strrchr(matches.gl_pathv[match], '/');
+      name = name ? name + 1 : matches.gl_pathv[match];
+
+      html_filename = (char*)calloc(strlen(tab + 1) + strlen(name) + strlen(".html") + 1, sizeof(char));
+      strcpy(html_filename, tab + 1);
+      strcat(html_filename, name);
+
+      extension = strrchr(html_filename, '.');
+      if(extension && extension > html_filename + strlen(tab + 1)) {
+	*extension = '\0';
+      }
+      strcat(html_filename, ".html");
+
+      add_to_batch(batch, matches.gl_pathv[match], html_filename);
+      free((void*)html_filename);
+    }
+
+    globfree(&matches);
+  }
+
+  fclose(file);
+
+  return valid;
 }
+
+#ifdef __linux__
+
+/* watches the directory holding the pgn, so that it is still seen when replaced by a new file */
+bool start_watch(WATCH *watch, const char *pgn_filename)
+{
+  char *directory;
+  const char *name;
+
+  name = strrchr(pgn_filename, '/');
+  if(name) {
+    directory = (char*)calloc(name - pgn_filename + 2, sizeof(char));
+    strncpy(directory, pgn_filename, name - pgn_filename + 1);
+    name++;
+  }
+  else {
+    directory = (char*)calloc(2, sizeof(char));
+    strcpy(directory, ".");
+    name = pgn_filename;
+  }
+
+  watch->name = (char*)calloc(strlen(name) + 1, sizeof(char));
+  strcpy(watch->name, name);
+
+  if((watch->fd = inotify_init()) == -1 ||
+     inotify_add_watch(watch->fd, directory, IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE) == -1) {
+    perror("Unable to watch pgn file");
+    free((void*)directory);
+    return false;
+  }
+
+  free((void*)directory);
+  return true;
+}
+
+/* blocks until the pgn has changed and then been left alone for a moment, false on error */
+bool wait_for_change(void *context)
+{
+  WATCH *watch = (WATCH*)context;
+  char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *event;
+  struct pollfd poll_fd;
+  bool changed = false;
+  ssize_t length;
+  char *c;
+
+  poll_fd.fd = watch->fd;
+  poll_fd.events = POLLIN;
+
+  /* wait for a change, then until the writer has been quiet for the settle time */
+  while(!changed || poll(&poll_fd, 1, SETTLE_TIME) > 0) {
+    if((length = read(watch->fd, buffer, sizeof(buffer))) <= 0) {
+      perror("Unable to watch pgn file");
+      return false;
+    }
+
+    for(c = buffer; c < buffer + length; c += sizeof(struct inotify_event) + event->len) {
+      event = (const struct inotify_event*)c;
+      if(event->len && !strcmp(event->name, watch->name)) {
+	changed = true;
+      }
+    }
+  }
+
+  return true;
+}
+
+#else
+
+/* only linux can watch files */
+bool start_watch(WATCH *watch, const char *pgn_filename)
+{
+  fprintf(stderr, "Watching a pgn file isn't supported on this system\n");
+  return false;
+}
+
+bool wait_for_change(void *context)
+{
+  return false;
+}
+
+#endif
@@ -0,0 +1,201 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* for copy_file_range */
+#endif
+
+#include "copy.h"
+
+/* windows copies the images with the shell */
+#ifndef WINDOWS
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define HAVE_COPY_FILE_RANGE
+#endif
+#endif
+
+/* function prototypes */
+bool copy_data(int in, int out, off_t size);
+bool copy_file(const char *source, const char *destination, const struct stat *source_stat);
+bool up_to_date(const struct stat *source_stat, const char *destination);
+
+/* copies the files in a directory (and any subdirectories), creating the destination if needed */
+bool copy_directory(const char *source, const char *destination)
+{
+  DIR *directory;
+  struct dirent *file;
+  struct stat source_stat;
+  char *source_filename, *destination_filename;
+  bool copied = true;
+
+  if(mkdir(destination, 0777) && errno != EEXIST) {
+    return false;
+  }
+
+  if((directory = opendir(source)) == NULL) {
+    return false;
+  }
+
+  while(copied && (file = readdir(directory))) {
+    if(!strcmp(file->d_name, ".") || !strcmp(file->d_name, "..")) {
+      continue;
+    }
+
+    source_filename = (char*)calloc(strlen(source) + strlen(file->d_name) + 2, sizeof(char));
+    sprintf(source_filename, "%s/%s", source, file->d_name);
+    destination_filename = (char*)calloc(strlen(destination) + strlen(file->d_name) + 2, sizeof(char));
+    sprintf(destination_filename, "%s/%s", destination, file->d_name);
+
+    if(stat(source_filename, &source_stat)) {
+      copied = false;
+    }
+    else if(S_ISDIR(source_stat.st_mode)) {
+      copied = copy_directory(source_filename, destination_filename);
+    }
+    else if(S_ISREG(source_stat.st_mode) && !up_to_date(&source_stat, destination_filename)) {
+      copied = copy_file(source_filename, destination_filename, &source_stat);
+    }
+
+    free((void*)source_filename);
+    free((void*)destination_filename);
+  }
+
+  closedir(directory);
+
+  return copied;
+}
+
+/* copies the contents of one file to another, in the kernel where possible */
+bool copy_data(int in, int out, off_t size)
+{
+  char buffer[65536];
+  ssize_t length, written, offset;
+
+#ifdef FICLONE
+  /* share the blocks on filesystems that can (btrfs, xfs etc) */
+  if(!ioctl(out, FICLONE, in)) {
+    return true;
+  }
+#endif
+
+#ifdef HAVE_COPY_FILE_RANGE
+  while(size > 0 && (length = copy_file_range(in, NULL, out, NULL, size, 0)) > 0) {
+    size -= length;
+  }
+  if(size == 0) {
+    return true;
+  }
+
+  /* not supported between these files, start again the slow way */
+  if(lseek(in, 0, SEEK_SET) == -1 || lseek(out, 0, SEEK_SET) == -1 || ftruncate(out, 0)) {
+    return false;
+  }
+#endif
+
+  while((length = read(in, buffer, sizeof(buffer))) > 0) {
+    for(offset = 0; offset < length; offset += written) {
+      if((written = write(out, buffer + offset, length - offset)) == -1) {
+	return false;
+      }
+    }
+  }
+
+  return length == 0;
+}
+
+/* copies a file, by hard link if allowed, giving the copy the same modification time */
+bool copy_file(const char *source, const char *destination, const struct stat *source_stat)
+{
+  struct timeval times[2];
+  int in, out;
+  bool copied;
+
+  /* replace any old copy */
+  if(unlink(destination) && errno != ENOENT) {
+    return false;
+  }
+
+  if(!link(source, destination)) {
+    return true;
+  }
+
+  if((in = open(source, O_RDONLY)) == -1) {
+    return false;
+  }
+
+  if((out = open(destination, O_WRONLY | O_CREAT | O_TRUNC, source_stat->st_mode & 0777)) == -1) {
+    close(in);
+    return false;
+  }
+
+  copied = copy_data(in, out, source_stat->st_size);
+
+  close(in);
+  if(close(out) && copied) {
+    copied = false;
+  }
+
+  /* matching times mark the copy as up to date */
+  times[0].tv_sec = source_stat->st_atime;
+  times[0].tv_usec = 0;
+  times[1].tv_sec = source_stat->st_mtime;
+  times[1].tv_usec = 0;
+
+  if(copied && utimes(destination, times)) {
+    copied = false;
+  }
+
+  if(!copied) {
+    unlink(destination);
+  }
+
+  return copied;
+}
+
+/* tests whether the destination already has the same size and modification time as the source */
+bool up_to_date(const struct stat *source_stat, const char *destination)
+{
+  struct stat destination_stat;
+
+  if(stat(destination, &destination_stat)) {
+    return false;
+  }
+
+  return S_ISREG(destination_stat.st_mode) && destination_stat.st_size == source_stat->st_size &&
+    destination_stat.st_mtime == source_stat->st_mtime;
+}
+
+#endif
@@ -0,0 +1,415 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "decompress.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WINDOWS
+#include <pthread.h>
+#endif
+
+#include <bzlib.h>
+#include <zlib.h>
+
+/* zstd is optional, build with -DHAVE_ZSTD and link with -lzstd to read .zst files */
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/* the compressed stream is read in chunks, which are handed to the decompressing thread */
+#define CHUNK_SIZE 262144
+#define CHUNKS 4
+
+/* decompression of one stream, the reading thread fills the chunks and the
+   decompressing thread empties them */
+typedef struct {
+  COMPRESSION compression;
+  z_stream gzip;
+  bz_stream bzip2;
+#ifdef HAVE_ZSTD
+  ZSTD_DStream *zstd;
+#endif
+  bool failed;
+  bool complete; /* the last compressed member has ended */
+
+  char *data; /* the decompressed text */
+  size_t length;
+  size_t size;
+
+  char *chunks[CHUNKS];
+  size_t chunk_lengths[CHUNKS];
+  int head;
+  int count;
+  bool finished; /* no more chunks will be read */
+
+#ifndef WINDOWS
+  pthread_mutex_t lock;
+  pthread_cond_t filled;
+  pthread_cond_t emptied;
+#endif
+} DECOMPRESSOR;
+
+/* function prototypes */
+bool begin_decompression(DECOMPRESSOR *decompressor);
+void *decompress_main(void *argument);
+bool decompress_chunk(DECOMPRESSOR *decompressor, const char *chunk, size_t length);
+void end_decompression(DECOMPRESSOR *decompressor);
+void reserve_output(DECOMPRESSOR *decompressor, size_t length);
+
+/* recognises a compressed format from the first bytes of a file */
+COMPRESSION compression_type(const char *magic, size_t length)
+{
+  const unsigned char *bytes = (const unsigned char*)magic;
+
+  if(length >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) {
+    return GZIP;
+  }
+
+  if(length >= 3 && !memcmp(magic, "BZh", 3)) {
+    return BZIP2;
+  }
+
+  if(length >= 4 && bytes[0] == 0x28 && bytes[1] == 0xb5 && bytes[2] == 0x2f && bytes[3] == 0xfd) {
+    return ZSTD;
+  }
+
+  return NOT_COMPRESSED;
+}
+
+/* reads and decompresses the rest of a stream, the reading overlaps with the
+   decompression which runs on a thread of its own. the text is only returned
+   once it is complete, parsing doesn't start until then */
+bool decompress_stream(FILE *stream, const char *prefix, size_t prefix_length, COMPRESSION compression,
+		       char **data, size_t *length)
+{
+  DECOMPRESSOR decompressor;
+  char *chunk;
+  size_t read;
+  int slot;
+  bool read_failed = false;
+  bool done;
+#ifndef WINDOWS
+  pthread_t thread;
+  bool threaded;
+#endif
+
+  memset(&decompressor, 0, sizeof(DECOMPRESSOR));
+  decompressor.compression = compression;
+
+  if(!begin_decompression(&decompressor)) {
+    return false;
+  }
+
+  for(slot = 0; slot < CHUNKS; slot++) {
+    decompressor.chunks[slot] = (char*)malloc(CHUNK_SIZE);
+  }
+
+#ifndef WINDOWS
+  pthread_mutex_init(&decompressor.lock, NULL);
+  pthread_cond_init(&decompressor.filled, NULL);
+  pthread_cond_init(&decompressor.emptied, NULL);
+
+  threaded = !pthread_create(&thread, NULL, decompress_main, &decompressor);
+#endif
+
+  /* the prefix starts the first chunk */
+  memcpy(decompressor.chunks[0], prefix, prefix_length);
+  read = prefix_length;
+  slot = 0;
+
+  for(;;) {
+    chunk = decompressor.chunks[slot];
+    read += fread(chunk + read, 1, CHUNK_SIZE - read, stream);
+
+    if(read < CHUNK_SIZE && ferror(stream)) {
+      read_failed = true;
+    }
+
+#ifndef WINDOWS
+    if(threaded) {
+      /* hand the chunk over and wait for an empty one */
+      pthread_mutex_lock(&decompressor.lock);
+
+      decompressor.chunk_lengths[slot] = read;
+      decompressor.count++;
+      decompressor.finished = (read < CHUNK_SIZE || read_failed || decompressor.failed);
+      pthread_cond_signal(&decompressor.filled);
+
+      while(!decompressor.finished && decompressor.count == CHUNKS) {
+	pthread_cond_wait(&decompressor.emptied, &decompressor.lock);
+      }
+
+      done = decompressor.finished || decompressor.failed;
+      pthread_mutex_unlock(&decompressor.lock);
+    }
+    else
+#endif
+    {
+      decompressor.failed = !decompress_chunk(&decompressor, chunk, read);
+      done = (read < CHUNK_SIZE || read_failed || decompressor.failed);
+    }
+
+    if(done) {
+      break;
+    }
+
+    slot = (slot + 1) % CHUNKS;
+    read = 0;
+  }
+
+#ifndef WINDOWS
+  if(threaded) {
+    /* the reader can stop early when decompression fails, so make sure the
+       decompressing thread isn't left waiting for another chunk */
+    pthread_mutex_lock(&decompressor.lock);
+    decompressor.finished = true;
+    pthread_cond_broadcast(&decompressor.filled);
+    pthread_mutex_unlock(&decompressor.lock);
+
+    pthread_join(thread, NULL);
+  }
+
+  pthread_mutex_destroy(&decompressor.lock);
+  pthread_cond_destroy(&decompressor.filled);
+  pthread_cond_destroy(&decompressor.emptied);
+#endif
+
+  for(slot = 0; slot < CHUNKS; slot++) {
+    free((void*)decompressor.chunks[slot]);
+  }
+
+  end_decompression(&decompressor);
+
+  /* a truncated stream is as bad as a damaged one */
+  if(decompressor.failed || read_failed || !decompressor.complete) {
+    free((void*)decompressor.data);
+    return false;
+  }
+
+  *data = decompressor.data;
+  *length = decompressor.length;
+
+  return true;
+}
+
+/* starts the decoder for the format */
+bool begin_decompression(DECOMPRESSOR *decompressor)
+{
+  decompressor->size = CHUNK_SIZE * 4;
+  decompressor->data = (char*)malloc(decompressor->size);
+
+  switch(decompressor->compression) {
+  case GZIP:
+    /* 15 + 32 detects the gzip header */
+    if(inflateInit2(&decompressor->gzip, 15 + 32) == Z_OK) {
+      return true;
+    }
+    break;
+  case BZIP2:
+    if(BZ2_bzDecompressInit(&decompressor->bzip2, 0, 0) == BZ_OK) {
+      return true;
+    }
+    break;
+  case ZSTD:
+#ifdef HAVE_ZSTD
+    if((decompressor->zstd = ZSTD_createDStream()) != NULL) {
+      ZSTD_initDStream(decompressor->zstd);
+      return true;
+    }
+#endif
+    break;
+  default:
+    break;
+  }
+
+  free((void*)decompressor->data);
+  return false;
+}
+
+/* empties the chunks as the reading thread fills them */
+void *decompress_main(void *argument)
+{
+#ifndef WINDOWS
+  DECOMPRESSOR *decompressor = (DECOMPRESSOR*)argument;
+  char *chunk;
+  size_t length;
+  bool failed = false;
+
+  pthread_mutex_lock(&decompressor->lock);
+
+  for(;;) {
+    while(decompressor->count == 0 && !decompressor->finished) {
+      pthread_cond_wait(&decompressor->filled, &decompressor->lock);
+    }
+
+    if(decompressor->count == 0) {
+      break;
+    }
+
+    chunk = decompressor->chunks[decompressor->head];
+    length = decompressor->chunk_lengths[decompressor->head];
+
+    /* the chunk is decompressed without holding the lock, it isn't reused until it is released */
+    pthread_mutex_unlock(&decompressor->lock);
+    failed = failed || !decompress_chunk(decompressor, chunk, length);
+    pthread_mutex_lock(&decompressor->lock);
+
+    decompressor->failed = failed;
+    decompressor->head = (decompressor->head + 1) % CHUNKS;
+    decompressor->count--;
+    pthread_cond_signal(&decompressor->emptied);
+  }
+
+  pthread_mutex_unlock(&decompressor->lock);
+#endif
+
+  return NULL;
+}
+
+/* decompresses a chunk onto the end of the text, a stream may hold several
+   compressed members one after the other (as made by pigz, pbzip2 etc) */
+bool decompress_chunk(DECOMPRESSOR *decompressor, const char *chunk, size_t length)
+{
+  int status;
+#ifdef HAVE_ZSTD
+  ZSTD_inBuffer in;
+  ZSTD_outBuffer out;
+  size_t result;
+#endif
+
+  switch(decompressor->compression) {
+  case GZIP:
+    decompressor->gzip.next_in = (Bytef*)chunk;
+    decompressor->gzip.avail_in = length;
+    decompressor->complete = decompressor->complete && !length;
+
+    while(decompressor->gzip.avail_in) {
+      reserve_output(decompressor, CHUNK_SIZE);
+      decompressor->gzip.next_out = (Bytef*)decompressor->data + decompressor->length;
+      decompressor->gzip.avail_out = decompressor->size - decompressor->length;
+
+      status = inflate(&decompressor->gzip, Z_NO_FLUSH);
+      decompressor->length = decompressor->size - decompressor->gzip.avail_out;
+
+      if(status == Z_STREAM_END) {
+	inflateReset(&decompressor->gzip);
+	decompressor->complete = true;
+      }
+      else if(status != Z_OK && status != Z_BUF_ERROR) {
+	return false;
+      }
+      else {
+	decompressor->complete = false;
+      }
+    }
+    return true;
+
+  case BZIP2:
+    decompressor->bzip2.next_in = (char*)chunk;
+    decompressor->bzip2.avail_in = length;
+    decompressor->complete = decompressor->complete && !length;
+
+    while(decompressor->bzip2.avail_in) {
+      reserve_output(decompressor, CHUNK_SIZE);
+      decompressor->bzip2.next_out = decompressor->data + decompressor->length;
+      decompressor->bzip2.avail_out = decompressor->size - decompressor->length;
+
+      status = BZ2_bzDecompress(&decompressor->bzip2);
+      decompressor->length = decompressor->size - decompressor->bzip2.avail_out;
+
+      if(status == BZ_STREAM_END) {
+	BZ2_bzDecompressEnd(&decompressor->bzip2);
+	if(BZ2_bzDecompressInit(&decompressor->bzip2, 0, 0) != BZ_OK) {
+	  return false;
+	}
+	decompressor->complete = true;
+      }
+      else if(status != BZ_OK) {
+	return false;
+      }
+      else {
+	decompressor->complete = false;
+      }
+    }
+    return true;
+
+  case ZSTD:
+#ifdef HAVE_ZSTD
+    in.src = chunk;
+    in.size = length;
+    in.pos = 0;
+
+    while(in.pos < in.size) {
+      reserve_output(decompressor, CHUNK_SIZE);
+      out.dst = decompressor->data;
+      out.size = decompressor->size;
+      out.pos = decompressor->length;
+
+      result = ZSTD_decompressStream(decompressor->zstd, &out, &in);
+      decompressor->length = out.pos;
+
+      if(ZSTD_isError(result)) {
+	return false;
+      }
+      decompressor->complete = (result == 0); /* the end of a frame */
+    }
+    return true;
+#endif
+
+  default:
+    return false;
+  }
+}
+
+/* frees the decoder */
+void end_decompression(DECOMPRESSOR *decompressor)
+{
+  switch(decompressor->compression) {
+  case GZIP:
+    inflateEnd(&decompressor->gzip);
+    break;
+  case BZIP2:
+    BZ2_bzDecompressEnd(&decompressor->bzip2);
+    break;
+  case ZSTD:
+#ifdef HAVE_ZSTD
+    ZSTD_freeDStream(decompressor->zstd);
+#endif
+    break;
+  default:
+    break;
+  }
+}
+
+/* makes room for at least length more bytes of text */
+void reserve_output(DECOMPRESSOR *decompressor, size_t length)
+{
+  if(decompressor->length + length <= decompressor->size) {
+    return;
+  }
+
+  while(decompressor->length + length > decompressor->size) {
+    decompressor->size *= 2;
+  }
+
+  decompressor->data = (char*)realloc((void*)decompressor->data, decompressor->size);
+}
@@ -0,0 +1,40 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _DECOMPRESS_H_
+#define _DECOMPRESS_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "bool.h"
+
+/* compressed formats, recognised by their magic bytes */
+typedef enum { NOT_COMPRESSED, GZIP, BZIP2, ZSTD } COMPRESSION;
+
+/* the most bytes needed to recognise a format */
+#define MAGIC_LENGTH 4
+
+/*** Function prototypes ***/
+
+COMPRESSION compression_type(const char *magic, size_t length); /** Recognises a compressed format from the first bytes of a file */
+bool decompress_stream(FILE *stream, const char *prefix, size_t prefix_length, COMPRESSION compression, char **data, size_t *length); /** Reads and decompresses the rest of a stream, whose first bytes were prefix. !! allocates *data, free after use !! */
+
+#endif
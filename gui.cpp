@@ -3,14 +3,15 @@
 /*** Custom progress event ***/
 
 DEFINE_EVENT_TYPE(wxEVT_UPDATE_PROGRESS)
+DEFINE_EVENT_TYPE(wxEVT_CONVERSION_DONE)
 
 /*** Progress Callback ***/
 
 void progress_callback(float percentage, void *context)
 {
-  //post event with integer precentage
+  //post event with the progress in tenths of a percent, so the bar still moves on huge files
   wxCommandEvent progressEvent(wxEVT_UPDATE_PROGRESS, ID_UPDATE_PROGRESS);
-  progressEvent.SetInt((int)percentage);
+  progressEvent.SetInt((int)(percentage * 10));
   ((wxEvtHandler*)context)->AddPendingEvent(progressEvent);
 } 
 
@@ -119,10 +120,17 @@ pgn2webThread::pgn2webThread(wxEvtHandler *listener, const wxString& resourcePat
 
 wxThread::ExitCode pgn2webThread::Entry()
 {
-  //simply call pgn2web function with stored parameters
-  pgn2web(m_resourcePath.mb_str(), m_PGNFilename.mb_str(), m_HTMLFilename.mb_str(), m_credit,
-	  m_pieces.mb_str(), m_layout, progress_callback, m_listener);
-  
+  //call pgn2web function with stored parameters
+  int error = pgn2web(m_resourcePath.mb_str(), m_PGNFilename.mb_str(), m_HTMLFilename.mb_str(), m_credit,
+		      m_pieces.mb_str(), m_layout, SIDECAR_INDEX, wxThread::GetCPUCount() > 0 ? wxThread::GetCPUCount() : 1,
+		      progress_callback, m_listener);
+
+  //always report the end, progress doesn't reach 100% on failure or for a pgn without games
+  wxCommandEvent doneEvent(wxEVT_CONVERSION_DONE, ID_CONVERSION_DONE);
+  doneEvent.SetInt(error);
+  doneEvent.SetString(wxString(pgn2web_error((P2W_ERROR)error), wxConvUTF8));
+  m_listener->AddPendingEvent(doneEvent);
+
   return NULL;
 }
 
@@ -135,7 +143,7 @@ ProgressDialog::ProgressDialog(wxWindow* parent) : wxDialog(parent, wxID_ANY, wx
 {
   progressText = new wxStaticText(this, -1, wxT("Converting PGN to HTML..."), wxDefaultPosition,
 				  wxDefaultSize, wxALIGN_CENTRE | wxST_NO_AUTORESIZE);
-  progressGauge = new wxGauge(this, -1, 100, wxDefaultPosition, wxDefaultSize,
+  progressGauge = new wxGauge(this, -1, 1000, wxDefaultPosition, wxDefaultSize,
 			      wxGA_HORIZONTAL|wxGA_SMOOTH);
   progressOk = new wxButton(this, wxID_OK, wxT("OK"));
 
@@ -145,15 +153,30 @@ ProgressDialog::ProgressDialog(wxWindow* parent) : wxDialog(parent, wxID_ANY, wx
 
 void ProgressDialog::updateProgress(wxCommandEvent& event)
 {
-  //update progress bar with new percentage
-  int percentage = event.GetInt();
-  progressGauge->SetValue(percentage);
+  //update progress bar with new progress (in tenths of a percent)
+  int progress = event.GetInt();
+  progressGauge->SetValue(progress);
+
+  //show the percentage, the end is reported by conversionDone
+  progressText->SetLabel(wxString::Format(wxT("Converting PGN to HTML... %d%%"), progress / 10));
+}
 
-  //if complete, display message and enable ok button
-  if(percentage == 100) {
+void ProgressDialog::conversionDone(wxCommandEvent& event)
+{
+  //display the outcome and enable ok button, a warning still leaves every page written
+  if(event.GetInt() == P2W_OK || P2W_WARNING(event.GetInt())) {
+    progressGauge->SetValue(1000);
     progressText->SetLabel(wxT("Conversion Complete"));
-    progressOk->Enable();
+    if(event.GetInt() != P2W_OK) {
+      wxMessageBox(event.GetString(), wxT("pgn2web"), wxOK | wxICON_WARNING, this);
+    }
   }
+  else {
+    progressText->SetLabel(wxT("Conversion Failed"));
+    wxMessageBox(event.GetString(), wxT("pgn2web"), wxOK | wxICON_ERROR, this);
+  }
+
+  progressOk->Enable();
 }
 
 void ProgressDialog::set_properties()
@@ -179,6 +202,7 @@ void ProgressDialog::do_layout()
 
 BEGIN_EVENT_TABLE(ProgressDialog, wxDialog)
   EVT_COMMAND(ID_UPDATE_PROGRESS, wxEVT_UPDATE_PROGRESS, ProgressDialog::updateProgress)
+  EVT_COMMAND(ID_CONVERSION_DONE, wxEVT_CONVERSION_DONE, ProgressDialog::conversionDone)
 END_EVENT_TABLE()
 
 
@@ -22,9 +22,10 @@ const wxChar SEPERATOR = wxT('/');
 
 //define event ids
 enum { ID_BROWSEPGN = (wxID_HIGHEST + 1), ID_BROWSEHTML, ID_CHOOSE, ID_CONVERT,
-       ID_UPDATE_PROGRESS };
+       ID_UPDATE_PROGRESS, ID_CONVERSION_DONE };
 
 DECLARE_EVENT_TYPE(wxEVT_UPDATE_PROGRESS, -1) //custom event type for progress updates
+DECLARE_EVENT_TYPE(wxEVT_CONVERSION_DONE, -1) //custom event type for the end of a conversion
 
 class PiecesView : public wxWindow {
 
@@ -71,6 +72,7 @@ class ProgressDialog : public wxDialog {
   ProgressDialog(wxWindow* parent);
 
   void updateProgress(wxCommandEvent& event);
+  void conversionDone(wxCommandEvent& event);
 
  private:
   void set_properties();
@@ -0,0 +1,335 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scan.h"
+
+/* index file layout (native byte order, it is only a cache):
+     "PGI2", byte order marker (4), pgn size (8), pgn mtime (8), checksum (8), prefix (8),
+     games (8) then for each game: offset (8), length (8), and each tag as a length (4)
+     followed by the text and its terminating nul */
+#define INDEX_MAGIC "PGI2"
+#define BYTE_ORDER_MARK 0x01020304U
+
+/* the checksum is taken eight bytes at a time from the start of the pgn, so the hash of
+   its whole words can be carried on over text added to the end */
+#define CHECKSUM_SEED 14695981039346656037ULL
+#define CHECKSUM_PRIME 1099511628211ULL
+
+#ifdef WINDOWS
+#define SEPERATOR '\\'
+#else
+#define SEPERATOR '/'
+#endif
+
+const char *TAG_NAMES[NO_TAGS] = {"Event", "Site", "Date", "Round", "White", "Black", "Result", "FEN"};
+
+/* function prototypes */
+void extend_index(PGN_INDEX *index, const INPUT *pgn);
+unsigned long long finish_checksum(unsigned long long prefix, const char *data, size_t length);
+unsigned long long hash_words(unsigned long long hash, const char *data, size_t words);
+bool read_value(INPUT *file, void *value, size_t size);
+bool write_value(FILE *file, const void *value, size_t size);
+
+/* computes a checksum of the pgn text, eight bytes at a time */
+unsigned long long index_checksum(const char *data, size_t length)
+{
+  return finish_checksum(hash_words(CHECKSUM_SEED, data, length / 8), data, length);
+}
+
+/* turns a pgn filename into the filename of its index, the buffer needs room for ".pgi" */
+void index_filename(char *filename)
+{
+  char *extension;
+
+  /* replace any extension (but not a dot in the path) */
+  extension = strrchr(filename, '.');
+  if(extension && !strchr(extension, SEPERATOR)) {
+    *extension = '\0';
+  }
+
+  strcat(filename, ".pgi");
+}
+
+/* frees an index and the tags it holds */
+void index_free(PGN_INDEX *index)
+{
+  size_t game;
+  int tag;
+
+  /* tags of a loaded index live in the index file, the rest were added since */
+  for(game = index->file ? index->known : 0; game < index->games; game++) {
+    for(tag = 0; tag < NO_TAGS; tag++) {
+      free((void*)index->entries[game].tags[tag]);
+    }
+  }
+
+  if(index->file) {
+    input_close(index->file);
+  }
+
+  free((void*)index->entries);
+  free((void*)index);
+}
+
+/* loads an index, NULL if it is missing, damaged or describes a different version of the pgn.
+   when appending, an index of a pgn which has since grown is extended to the new games */
+PGN_INDEX *index_load(const char *filename, const INPUT *pgn, bool append)
+{
+  INPUT *file;
+  PGN_INDEX *index;
+  char magic[4];
+  unsigned int byte_order_mark;
+  unsigned long long size, mtime, stored_checksum, stored_prefix, prefix, games, offset, length;
+  unsigned int tag_length;
+  size_t game;
+  int tag;
+  bool current, grown;
+
+  if((file = input_open(filename)) == NULL) {
+    return NULL;
+  }
+
+  if(!read_value(file, magic, 4) || memcmp(magic, INDEX_MAGIC, 4) ||
+     !read_value(file, &byte_order_mark, 4) || byte_order_mark != BYTE_ORDER_MARK ||
+     !read_value(file, &size, 8) || !read_value(file, &mtime, 8) || !read_value(file, &stored_checksum, 8) ||
+     !read_value(file, &stored_prefix, 8) || !read_value(file, &games, 8) || games > (file->length - file->position) / 16) {
+    input_close(file);
+    return NULL;
+  }
+
+  /* check the index describes the pgn as it is now, or as it was before games were added */
+  current = (size == pgn->length && mtime == (unsigned long long)pgn->mtime);
+  grown = (append && games > 0 && size < pgn->length);
+
+  /* the text the index was made from is read once, then the hash carries on over any added */
+  if(current || grown) {
+    prefix = hash_words(CHECKSUM_SEED, pgn->data, size / 8);
+    if(prefix != stored_prefix || finish_checksum(prefix, pgn->data, size) != stored_checksum) {
+      current = grown = false;
+    }
+  }
+
+  if(!current && !grown) {
+    input_close(file);
+    return NULL;
+  }
+
+  if(grown) {
+    prefix = hash_words(prefix, pgn->data + size / 8 * 8, pgn->length / 8 - size / 8);
+  }
+
+  index = (PGN_INDEX*)calloc(1, sizeof(PGN_INDEX));
+  index->file = file;
+  index->size = pgn->length;
+  index->mtime = pgn->mtime;
+  index->prefix = prefix;
+  index->checksum = finish_checksum(prefix, pgn->data, pgn->length);
+  index->entries = (INDEX_ENTRY*)calloc(games ? games : 1, sizeof(INDEX_ENTRY));
+
+  /* read the entries, the tags are used in place. every game read so far counts as known,
+     so that index_free leaves its tags in the index file if the rest is damaged */
+  for(game = 0; game < games; game++) {
+    if(!read_value(file, &offset, 8) || !read_value(file, &length, 8) || offset + length > pgn->length) {
+      index_free(index);
+      return NULL;
+    }
+
+    index->entries[game].offset = offset;
+    index->entries[game].length = length;
+    index->games = index->known = game + 1;
+
+    for(tag = 0; tag < NO_TAGS; tag++) {
+      if(!read_value(file, &tag_length, 4) || tag_length == 0 ||
+	 tag_length > file->length - file->position || file->data[file->position + tag_length - 1] != '\0') {
+	index_free(index);
+	return NULL;
+      }
+
+      index->entries[game].tags[tag] = (char*)file->data + file->position;
+      file->position += tag_length;
+    }
+  }
+
+  if(grown) {
+    extend_index(index, pgn);
+  }
+
+  return index;
+}
+
+/* writes an index, all the tags must be known */
+bool index_save(const PGN_INDEX *index, const char *filename)
+{
+  FILE *file;
+  char *temp_filename;
+  unsigned int byte_order_mark = BYTE_ORDER_MARK;
+  unsigned long long value;
+  unsigned int tag_length;
+  size_t game;
+  int tag;
+  bool written;
+
+  /* write to a temporary file which replaces the index once complete */
+  temp_filename = (char*)calloc(strlen(filename) + strlen(".tmp") + 1, sizeof(char));
+  strcpy(temp_filename, filename);
+  strcat(temp_filename, ".tmp");
+
+  if((file = fopen(temp_filename, "wb")) == NULL) {
+    free((void*)temp_filename);
+    return false;
+  }
+
+  written = write_value(file, INDEX_MAGIC, 4) && write_value(file, &byte_order_mark, 4);
+  value = index->size;
+  written = written && write_value(file, &value, 8);
+  value = (unsigned long long)index->mtime;
+  written = written && write_value(file, &value, 8);
+  value = index->checksum;
+  written = written && write_value(file, &value, 8);
+  value = index->prefix;
+  written = written && write_value(file, &value, 8);
+  value = index->games;
+  written = written && write_value(file, &value, 8);
+
+  for(game = 0; written && game < index->games; game++) {
+    value = index->entries[game].offset;
+    written = write_value(file, &value, 8);
+    value = index->entries[game].length;
+    written = written && write_value(file, &value, 8);
+
+    for(tag = 0; written && tag < NO_TAGS; tag++) {
+      tag_length = strlen(index->entries[game].tags[tag]) + 1;
+      written = write_value(file, &tag_length, 4) && write_value(file, index->entries[game].tags[tag], tag_length);
+    }
+  }
+
+  if(fclose(file) || !written || rename(temp_filename, filename)) {
+    remove(temp_filename);
+    written = false;
+  }
+
+  free((void*)temp_filename);
+
+  return written;
+}
+
+/* creates an index by scanning the pgn for games, the tags are left unknown. the
+   checksum is only needed (and taken) for an index which is to be saved */
+PGN_INDEX *index_scan(const INPUT *pgn, bool checksum)
+{
+  PGN_INDEX *index;
+  GAME_EXTENT *extents;
+  size_t game;
+
+  index = (PGN_INDEX*)calloc(1, sizeof(PGN_INDEX));
+  index->games = scan_games(pgn->data, pgn->length, &extents); /* !! allocates memory to extents !! */
+  index->entries = (INDEX_ENTRY*)calloc(index->games ? index->games : 1, sizeof(INDEX_ENTRY));
+
+  for(game = 0; game < index->games; game++) {
+    index->entries[game].offset = extents[game].offset;
+    index->entries[game].length = extents[game].length;
+  }
+
+  index->size = pgn->length;
+  index->mtime = pgn->mtime;
+
+  if(checksum) {
+    index->prefix = hash_words(CHECKSUM_SEED, pgn->data, pgn->length / 8);
+    index->checksum = finish_checksum(index->prefix, pgn->data, pgn->length);
+  }
+
+  free((void*)extents);
+
+  return index;
+}
+
+/* rescans the pgn from the start of the last game, which may have been incomplete,
+   replacing it and adding any games after it with their tags unknown */
+void extend_index(PGN_INDEX *index, const INPUT *pgn)
+{
+  GAME_EXTENT *extents;
+  size_t start, tail, game;
+
+  index->known = index->games - 1;
+  start = index->entries[index->known].offset;
+
+  tail = scan_games(pgn->data + start, pgn->length - start, &extents); /* !! allocates memory to extents !! */
+
+  index->games = index->known + tail;
+  index->entries = (INDEX_ENTRY*)realloc((void*)index->entries, (index->games ? index->games : 1) * sizeof(INDEX_ENTRY));
+
+  for(game = 0; game < tail; game++) {
+    memset(&index->entries[index->known + game], 0, sizeof(INDEX_ENTRY));
+    index->entries[index->known + game].offset = start + extents[game].offset;
+    index->entries[index->known + game].length = extents[game].length;
+  }
+
+  free((void*)extents);
+}
+
+/* completes a checksum from the hash of the whole words of the text, taking in the bytes after them */
+unsigned long long finish_checksum(unsigned long long prefix, const char *data, size_t length)
+{
+  size_t offset;
+
+  for(offset = length / 8 * 8; offset < length; offset++) {
+    prefix = (prefix ^ (unsigned char)data[offset]) * CHECKSUM_PRIME;
+  }
+
+  return prefix ^ length;
+}
+
+/* carries a hash on over a number of eight byte words */
+unsigned long long hash_words(unsigned long long hash, const char *data, size_t words)
+{
+  unsigned long long word;
+
+  for(; words; words--, data += 8) {
+    memcpy(&word, data, 8);
+    hash = (hash ^ word) * CHECKSUM_PRIME;
+  }
+
+  return hash;
+}
+
+/* reads a value from the index file */
+bool read_value(INPUT *file, void *value, size_t size)
+{
+  if(file->length - file->position < size) {
+    return false;
+  }
+
+  memcpy(value, file->data + file->position, size);
+  file->position += size;
+
+  return true;
+}
+
+/* writes a value to the index file */
+bool write_value(FILE *file, const void *value, size_t size)
+{
+  return fwrite(value, 1, size, file) == size;
+}
@@ -0,0 +1,73 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _INDEX_H_
+#define _INDEX_H_
+
+#include <stddef.h>
+#include <time.h>
+
+#include "bool.h"
+#include "input.h"
+
+/* tags recorded for each game, the seven tag roster plus the starting position */
+#define TAG_EVENT  0
+#define TAG_SITE   1
+#define TAG_DATE   2
+#define TAG_ROUND  3
+#define TAG_WHITE  4
+#define TAG_BLACK  5
+#define TAG_RESULT 6
+#define TAG_FEN    7
+#define NO_TAGS    8
+
+extern const char *TAG_NAMES[NO_TAGS];
+
+/* where a game lies in the pgn and its tags (NULL until known) */
+typedef struct {
+  size_t offset;
+  size_t length;
+  char *tags[NO_TAGS];
+} INDEX_ENTRY;
+
+/* index of every game in a pgn file, and the identity of the file it describes */
+typedef struct {
+  size_t games;
+  INDEX_ENTRY *entries;
+  size_t known; /* the tags of games before this are known */
+
+  unsigned long long size;
+  time_t mtime;
+  unsigned long long checksum;
+  unsigned long long prefix; /* the hash of the pgn's whole eight byte words, carried on when it grows */
+
+  INPUT *file; /* when loaded, the tags point into the mapped index file */
+} PGN_INDEX;
+
+/*** Function prototypes ***/
+
+unsigned long long index_checksum(const char *data, size_t length); /** Computes a checksum of the pgn text */
+void index_filename(char *filename); /** Turns a pgn filename into the filename of its index */
+void index_free(PGN_INDEX *index); /** Frees an index and the tags it holds */
+PGN_INDEX *index_load(const char *filename, const INPUT *pgn, bool append); /** Loads an index, NULL if missing, damaged or out of date. With append an index of the start of the pgn is extended */
+bool index_save(const PGN_INDEX *index, const char *filename); /** Writes an index, all tags must be known */
+PGN_INDEX *index_scan(const INPUT *pgn, bool checksum); /** Creates an index by scanning the pgn, the tags are left unknown. The checksum is only taken if asked for */
+
+#endif
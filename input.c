@@ -0,0 +1,296 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* pgn files can be larger than 2GB, so ask for a 64 bit off_t where it isn't already */
+#define _FILE_OFFSET_BITS 64
+
+#include "input.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decompress.h"
+
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* function prototypes */
+INPUT *open_input(const char *filename, bool map);
+bool read_stream(FILE *stream, const char *prefix, size_t prefix_length, INPUT *input);
+
+/* unmaps or frees the input */
+void input_close(INPUT *input)
+{
+#ifndef WINDOWS
+  if(input->mapped) {
+    munmap((void*)input->data, input->length);
+  }
+  else {
+    free((void*)input->data);
+  }
+#else
+  free((void*)input->data);
+#endif
+
+  free((void*)input);
+}
+
+/* tests whether all of the input has been consumed */
+bool input_eof(const INPUT *input)
+{
+  return input->position >= input->length;
+}
+
+/* reads the next character */
+int input_getc(INPUT *input)
+{
+  if(input->position >= input->length) {
+    return INPUT_EOF;
+  }
+
+  return (unsigned char)input->data[input->position++];
+}
+
+/* reads a line (including the newline) into buffer, at most size - 1 characters are read */
+char *input_gets(INPUT *input, char *buffer, int size)
+{
+  const char *start, *newline;
+  size_t length;
+
+  if(input->position >= input->length) {
+    return NULL;
+  }
+
+  start = input->data + input->position;
+  length = input->length - input->position;
+  if(length > (size_t)(size - 1)) {
+    length = size - 1;
+  }
+
+  /* stop after the newline if there is one within reach */
+  if((newline = memchr(start, '\n', length))) {
+    length = newline - start + 1;
+  }
+
+  memcpy(buffer, start, length);
+  buffer[length] = '\0';
+  input->position += length;
+
+  return buffer;
+}
+
+/* opens a pgn file, mapping it into memory if possible. compressed files are
+   decompressed into memory as they are read */
+INPUT *input_open(const char *filename)
+{
+  return open_input(filename, true);
+}
+
+/* opens a pgn file by reading it into memory, never mapping it. a mapping of a file which
+   is truncated while it is used faults (SIGBUS) when the pages past the new end are read,
+   a copy is only ever a snapshot */
+INPUT *input_read(const char *filename)
+{
+  return open_input(filename, false);
+}
+
+/* moves the cursor back to the start of the input */
+void input_rewind(INPUT *input)
+{
+  input->position = 0;
+}
+
+/* advances the cursor to the next occurrence of c, or the end of the input */
+void input_skip_to(INPUT *input, char c)
+{
+  const char *found;
+
+  if(input->position >= input->length) {
+    return;
+  }
+
+  found = memchr(input->data + input->position, c, input->length - input->position);
+  input->position = found ? (size_t)(found - input->data) : input->length;
+}
+
+/* steps the cursor back over the last character read */
+void input_ungetc(INPUT *input)
+{
+  if(input->position > 0 && input->position <= input->length) {
+    input->position--;
+  }
+}
+
+/* sets up view to cover the bytes from start up to end of input, the data is shared so the view must not be closed */
+void input_view(INPUT *view, const INPUT *input, size_t start, size_t end)
+{
+  view->data = input->data + start;
+  view->length = end - start;
+  view->position = 0;
+  view->mtime = 0;
+  view->mapped = false;
+}
+
+/* opens a pgn file for input_open or input_read, regular files are mapped if map is set */
+INPUT *open_input(const char *filename, bool map)
+{
+  INPUT *input;
+  FILE *stream;
+  char magic[MAGIC_LENGTH];
+  size_t magic_length;
+  COMPRESSION compression;
+  char *text;
+  bool read;
+#ifndef WINDOWS
+  int fd;
+  struct stat stat_buf;
+  void *data;
+#endif
+
+  input = (INPUT*)calloc(1, sizeof(INPUT));
+
+#ifndef WINDOWS
+  /* regular files are mapped, anything else (pipes, terminals etc) is read in */
+  if(strcmp(filename, "-")) {
+    if((fd = open(filename, O_RDONLY)) == -1) {
+      free((void*)input);
+      return NULL;
+    }
+
+    if(!fstat(fd, &stat_buf) && S_ISREG(stat_buf.st_mode)) {
+      /* the whole file is held in memory, which a 32 bit system may not have room for */
+      if((unsigned long long)stat_buf.st_size > (size_t)-1) {
+	close(fd);
+	free((void*)input);
+	return NULL;
+      }
+
+      input->length = stat_buf.st_size;
+      input->mtime = stat_buf.st_mtime;
+
+      /* an empty file can't be mapped, but there is nothing to read either */
+      if(input->length == 0) {
+	close(fd);
+	return input;
+      }
+
+      /* a compressed file is read as a stream */
+      if(!map || (pread(fd, magic, MAGIC_LENGTH, 0) == MAGIC_LENGTH && compression_type(magic, MAGIC_LENGTH) != NOT_COMPRESSED)) {
+	data = MAP_FAILED;
+      }
+      else {
+	data = mmap(NULL, input->length, PROT_READ, MAP_PRIVATE, fd, 0);
+      }
+
+      if(data != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+	madvise(data, input->length, MADV_SEQUENTIAL);
+#endif
+	input->data = (const char*)data;
+	input->mapped = true;
+	close(fd);
+	return input;
+      }
+
+      input->length = 0;
+    }
+
+    close(fd);
+  }
+#endif
+
+  /* fallback, read the whole stream into memory */
+  if(!strcmp(filename, "-")) {
+    stream = stdin;
+  }
+  else if((stream = fopen(filename, "rb")) == NULL) {
+    free((void*)input);
+    return NULL;
+  }
+
+  /* the first bytes tell whether the stream is compressed */
+  magic_length = fread(magic, 1, MAGIC_LENGTH, stream);
+  compression = compression_type(magic, magic_length);
+
+  if(compression != NOT_COMPRESSED) {
+    read = decompress_stream(stream, magic, magic_length, compression, &text, &input->length);
+    input->data = read ? text : NULL;
+    input->mapped = false;
+  }
+  else {
+    read = read_stream(stream, magic, magic_length, input);
+  }
+
+  if(!read) {
+    if(stream != stdin) {
+      fclose(stream);
+    }
+    free((void*)input);
+    return NULL;
+  }
+
+  if(stream != stdin) {
+    fclose(stream);
+  }
+
+  return input;
+}
+
+/* reads the whole of a stream into a heap buffer, the first bytes have already been read into prefix */
+bool read_stream(FILE *stream, const char *prefix, size_t prefix_length, INPUT *input)
+{
+  char *data;
+  size_t size = 65536;
+  size_t read;
+
+  data = (char*)malloc(size);
+  memcpy(data, prefix, prefix_length);
+  input->length = prefix_length;
+
+  do {
+    /* grow the buffer geometrically */
+    if(input->length == size) {
+      if(size > (size_t)-1 / 2) {
+	free((void*)data);
+	return false;
+      }
+      size *= 2;
+      data = (char*)realloc((void*)data, size);
+    }
+
+    read = fread(data + input->length, 1, size - input->length, stream);
+    input->length += read;
+  } while(read);
+
+  if(ferror(stream)) {
+    free((void*)data);
+    return false;
+  }
+
+  input->data = data;
+  input->mapped = false;
+
+  return true;
+}
@@ -0,0 +1,55 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _INPUT_H_
+#define _INPUT_H_
+
+#include <stddef.h>
+#include <time.h>
+
+#include "bool.h"
+
+/* pgn input, the whole file is held in memory (mapped where possible) and
+   the parser walks it with a simple cursor */
+typedef struct {
+  const char *data;
+  size_t length;
+  size_t position;
+
+  time_t mtime; /* modification time of a regular file, 0 for other inputs */
+  bool mapped;
+} INPUT;
+
+#define INPUT_EOF (-1)
+
+/*** Function prototypes ***/
+
+void input_close(INPUT *input); /** Unmaps or frees the input */
+bool input_eof(const INPUT *input); /** Tests whether all of the input has been consumed */
+int input_getc(INPUT *input); /** Reads the next character, INPUT_EOF if there are none left */
+char *input_gets(INPUT *input, char *buffer, int size); /** Reads a line into buffer, behaves as fgets */
+INPUT *input_open(const char *filename); /** Opens a pgn file, "-" reads standard input. Returns NULL on failure */
+INPUT *input_read(const char *filename); /** As input_open, but reads the file into memory rather than mapping it */
+void input_rewind(INPUT *input); /** Moves the cursor back to the start of the input */
+void input_skip_to(INPUT *input, char c); /** Advances the cursor to the next occurrence of c (or the end) */
+void input_ungetc(INPUT *input); /** Steps the cursor back over the last character read */
+void input_view(INPUT *view, const INPUT *input, size_t start, size_t end); /** Sets up view to cover part of input, views must not be closed */
+
+#endif
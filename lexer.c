@@ -0,0 +1,166 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "lexer.h"
+
+#include <ctype.h>
+#include <string.h>
+
+/* where the lexer is within a token */
+typedef enum { LEX_START, LEX_SYMBOL, LEX_COMMENT, LEX_NAG, LEX_MOVE_NUMBER } LEX_STATE;
+
+/* function prototypes */
+size_t result_length(const char *text, size_t length);
+
+/* reads the next token of the movetext in a single pass over the input, leaving the
+   cursor after it. whitespace, and characters which can't start a token (annotation
+   glyphs such as ! and ?), are skipped */
+TOKEN_TYPE lexer_next(INPUT *input, TOKEN *token)
+{
+  const char *data = input->data;
+  size_t length = input->length;
+  size_t position = input->position;
+  size_t start = position;
+  const char *brace;
+  LEX_STATE state = LEX_START;
+  unsigned char c;
+
+  for(;;) {
+    c = (position < length) ? (unsigned char)data[position] : '\0';
+
+    switch(state) {
+    case LEX_START:
+      start = position;
+
+      if(position >= length) {
+	token->type = TOKEN_END;
+	token->text = data + position;
+	token->length = 0;
+	input->position = position;
+	return TOKEN_END;
+      }
+
+      if(c == '{') {
+	state = LEX_COMMENT;
+	start = position + 1;
+	continue;
+      }
+
+      if(c == '(' || c == ')') {
+	token->type = (c == '(') ? TOKEN_OPEN_VARIATION : TOKEN_CLOSE_VARIATION;
+	token->text = data + position;
+	token->length = 1;
+	input->position = position + 1;
+	return token->type;
+      }
+
+      if(c == '$') {
+	state = LEX_NAG;
+	start = position + 1;
+	position++;
+	continue;
+      }
+
+      /* a result is a whole word, otherwise 1-0 would be taken for a move number */
+      if((c == '1' || c == '0' || c == '*') && (token->length = result_length(data + position, length - position))) {
+	token->type = TOKEN_RESULT;
+	token->text = data + position;
+	input->position = position + token->length;
+	return TOKEN_RESULT;
+      }
+
+      if(isdigit(c) || c == '.') {
+	state = LEX_MOVE_NUMBER;
+      }
+      else if(isalnum(c) || c == '+' || c == '-' || c == '#' || c == '=') {
+	state = LEX_SYMBOL;
+      }
+
+      position++;
+      continue;
+
+    case LEX_COMMENT:
+      /* comments don't nest, so the text runs to the next closing brace */
+      brace = (const char*)memchr(data + start, '}', length - start);
+
+      token->type = TOKEN_COMMENT;
+      token->text = data + start;
+      token->length = (brace ? (size_t)(brace - data) : length) - start;
+      input->position = brace ? (size_t)(brace - data) + 1 : length;
+      return TOKEN_COMMENT;
+
+    case LEX_NAG:
+      if(isdigit(c)) {
+	position++;
+	continue;
+      }
+
+      token->type = TOKEN_NAG;
+      token->text = data + start;
+      token->length = position - start;
+      input->position = position;
+      return TOKEN_NAG;
+
+    case LEX_MOVE_NUMBER:
+      if(isdigit(c) || c == '.') {
+	position++;
+	continue;
+      }
+
+      token->type = TOKEN_MOVE_NUMBER;
+      token->text = data + start;
+      token->length = position - start;
+      input->position = position;
+      return TOKEN_MOVE_NUMBER;
+
+    case LEX_SYMBOL:
+      if(isalnum(c) || c == '+' || c == '-' || c == '#' || c == '=') {
+	position++;
+	continue;
+      }
+
+      token->type = TOKEN_SYMBOL;
+      token->text = data + start;
+      token->length = position - start;
+      input->position = position;
+      return TOKEN_SYMBOL;
+    }
+  }
+}
+
+/* returns the length of the game result which is the word at the start of text, 0 if it isn't one */
+size_t result_length(const char *text, size_t length)
+{
+  static const char *results[] = {"1-0", "0-1", "1/2-1/2", "*"};
+  size_t word;
+  int result;
+
+  for(word = 0; word < length && !isspace((unsigned char)text[word]); word++) {
+  }
+
+  for(result = 0; result < 4; result++) {
+    if(word == strlen(results[result]) && !memcmp(text, results[result], word)) {
+      return word;
+    }
+  }
+
+  return 0;
+}
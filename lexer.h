@@ -0,0 +1,47 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef _LEXER_H_
+#define _LEXER_H_
+
+#include <stddef.h>
+
+#include "input.h"
+
+/* the kinds of token in pgn movetext */
+typedef enum {
+  TOKEN_END, TOKEN_SYMBOL, TOKEN_COMMENT, TOKEN_NAG, TOKEN_OPEN_VARIATION,
+  TOKEN_CLOSE_VARIATION, TOKEN_MOVE_NUMBER, TOKEN_RESULT
+} TOKEN_TYPE;
+
+/* a token's text points into the input rather than being copied, so it isn't nul terminated.
+   a comment's text is between the braces and a nag's is the number after the $ */
+typedef struct {
+  TOKEN_TYPE type;
+  const char *text;
+  size_t length;
+} TOKEN;
+
+/*** Function prototypes ***/
+
+TOKEN_TYPE lexer_next(INPUT *input, TOKEN *token); /** Reads the next token of the movetext, TOKEN_END at the end of the input */
+
+#endif
@@ -0,0 +1,152 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "manifest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "index.h"
+
+/* the manifest is a text file, a header line, the list hash, the number of games and then
+   the hash of each game's page */
+#define MANIFEST_HEADER "pgn2web manifest 1"
+
+#ifdef WINDOWS
+#define SEPERATOR '\\'
+#else
+#define SEPERATOR '/'
+#endif
+
+/* creates an empty manifest for a number of games */
+MANIFEST *manifest_create(size_t games)
+{
+  MANIFEST *manifest;
+
+  manifest = (MANIFEST*)calloc(1, sizeof(MANIFEST));
+  manifest->games = games;
+  manifest->pages = (unsigned long long*)calloc(games ? games : 1, sizeof(unsigned long long));
+
+  return manifest;
+}
+
+/* turns a html filename into the filename of its manifest */
+void manifest_filename(char *filename)
+{
+  char *extension;
+
+  /* replace any extension (but not a dot in the path) */
+  extension = strrchr(filename, '.');
+  if(extension && !strchr(extension, SEPERATOR)) {
+    *extension = '\0';
+  }
+
+  strcat(filename, ".manifest");
+}
+
+/* frees a manifest */
+void manifest_free(MANIFEST *manifest)
+{
+  free((void*)manifest->pages);
+  free((void*)manifest);
+}
+
+/* adds some data to a hash */
+unsigned long long manifest_hash(unsigned long long hash, const void *data, size_t length)
+{
+  return (hash ^ index_checksum((const char*)data, length)) * 1099511628211ULL;
+}
+
+/* loads a manifest, NULL if it is missing or damaged */
+MANIFEST *manifest_load(const char *filename)
+{
+  FILE *file;
+  MANIFEST *manifest;
+  char header[64];
+  unsigned long long list;
+  unsigned long games;
+  size_t game;
+
+  if((file = fopen(filename, "r")) == NULL) {
+    return NULL;
+  }
+
+  if(fgets(header, sizeof(header), file) == NULL || strcmp(header, MANIFEST_HEADER "\n") ||
+     fscanf(file, "list %llx\n", &list) != 1 || fscanf(file, "games %lu\n", &games) != 1) {
+    fclose(file);
+    return NULL;
+  }
+
+  manifest = manifest_create(games);
+  manifest->list = list;
+
+  if(manifest->pages == NULL) {
+    free((void*)manifest);
+    fclose(file);
+    return NULL;
+  }
+
+  for(game = 0; game < games; game++) {
+    if(fscanf(file, "%llx\n", &manifest->pages[game]) != 1) {
+      manifest_free(manifest);
+      fclose(file);
+      return NULL;
+    }
+  }
+
+  fclose(file);
+
+  return manifest;
+}
+
+/* writes a manifest, through a temporary file so that a failed write leaves no manifest */
+bool manifest_save(const MANIFEST *manifest, const char *filename)
+{
+  FILE *file;
+  char *temp_filename;
+  size_t game;
+  bool written;
+
+  temp_filename = (char*)calloc(strlen(filename) + strlen(".tmp") + 1, sizeof(char));
+  strcpy(temp_filename, filename);
+  strcat(temp_filename, ".tmp");
+
+  if((file = fopen(temp_filename, "w")) == NULL) {
+    free((void*)temp_filename);
+    return false;
+  }
+
+  fprintf(file, "%s\nlist %016llx\ngames %lu\n", MANIFEST_HEADER, manifest->list, (unsigned long)manifest->games);
+  for(game = 0; game < manifest->games; game++) {
+    fprintf(file, "%016llx\n", manifest->pages[game]);
+  }
+
+  written = !ferror(file);
+  if(fclose(file) || !written || rename(temp_filename, filename)) {
+    remove(temp_filename);
+    written = false;
+  }
+
+  free((void*)temp_filename);
+
+  return written;
+}
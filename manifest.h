@@ -0,0 +1,48 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef _MANIFEST_H_
+#define _MANIFEST_H_
+
+#include <stddef.h>
+
+#include "bool.h"
+
+/* what the pages of a conversion were made from, so that an update can leave alone
+   the pages whose inputs haven't changed */
+typedef struct {
+  unsigned long long list; /* hash of the game list and the templates and options of its pages */
+  size_t games;
+  unsigned long long *pages; /* hash of each game's text, template and options */
+} MANIFEST;
+
+#define MANIFEST_SEED 14695981039346656037ULL
+
+/*** Function prototypes ***/
+
+MANIFEST *manifest_create(size_t games); /** Creates an empty manifest for a number of games */
+void manifest_filename(char *filename); /** Turns a html filename into the filename of its manifest */
+void manifest_free(MANIFEST *manifest); /** Frees a manifest */
+unsigned long long manifest_hash(unsigned long long hash, const void *data, size_t length); /** Adds some data to a hash, start with MANIFEST_SEED */
+MANIFEST *manifest_load(const char *filename); /** Loads a manifest, NULL if it is missing or damaged */
+bool manifest_save(const MANIFEST *manifest, const char *filename); /** Writes a manifest */
+
+#endif
@@ -0,0 +1,269 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "page.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <zlib.h>
+
+/* brotli is optional, build with -DHAVE_BROTLI and link with -lbrotlienc to write .br pages */
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+/* the pages are compressed once to be served many times, but brotli's best is
+   too slow to keep up with the conversion */
+#define BROTLI_QUALITY 9
+
+/* function prototypes */
+void grow_page(PAGE *page, size_t length);
+bool save_data(const char *filename, const char *suffix, const char *data, size_t length, bool binary);
+
+/* compresses the page with brotli into a new page */
+bool page_brotli(const PAGE *page, PAGE *compressed)
+{
+#ifdef HAVE_BROTLI
+  compressed->size = BrotliEncoderMaxCompressedSize(page->length);
+  compressed->data = (char*)malloc(compressed->size ? compressed->size : 1);
+  compressed->length = compressed->size;
+
+  if(!compressed->size || !BrotliEncoderCompress(BROTLI_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+						  page->length, (const uint8_t*)page->data,
+						  &compressed->length, (uint8_t*)compressed->data)) {
+    page_free(compressed);
+    return false;
+  }
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+/* returns whether pages can be compressed with brotli, it is only there if built in */
+bool page_brotli_available(void)
+{
+#ifdef HAVE_BROTLI
+  return true;
+#else
+  return false;
+#endif
+}
+
+/* frees the text of the page */
+void page_free(PAGE *page)
+{
+  free((void*)page->data);
+}
+
+/* compresses the page with gzip into a new page */
+bool page_gzip(const PAGE *page, PAGE *compressed)
+{
+  z_stream stream;
+
+  memset(&stream, 0, sizeof(z_stream));
+
+  /* 15 + 16 writes a gzip header rather than a zlib one */
+  if(deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+
+  compressed->size = deflateBound(&stream, page->length);
+  compressed->data = (char*)malloc(compressed->size);
+
+  stream.next_in = (Bytef*)page->data;
+  stream.avail_in = page->length;
+  stream.next_out = (Bytef*)compressed->data;
+  stream.avail_out = compressed->size;
+
+  if(deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+    deflateEnd(&stream);
+    page_free(compressed);
+    return false;
+  }
+
+  compressed->length = stream.total_out;
+  deflateEnd(&stream);
+
+  return true;
+}
+
+/* starts an empty page */
+void page_init(PAGE *page)
+{
+  page->size = 16384;
+  page->length = 0;
+  page->data = (char*)malloc(page->size);
+}
+
+/* appends formatted text */
+void page_printf(PAGE *page, const char *format, ...)
+{
+  va_list arguments;
+  int length;
+
+  /* try the space left, and if that is too little try again with enough */
+  va_start(arguments, format);
+  length = vsnprintf(page->data + page->length, page->size - page->length, format, arguments);
+  va_end(arguments);
+
+  if(length < 0) {
+    return;
+  }
+
+  if((size_t)length >= page->size - page->length) {
+    grow_page(page, length + 1);
+    va_start(arguments, format);
+    vsnprintf(page->data + page->length, page->size - page->length, format, arguments);
+    va_end(arguments);
+  }
+
+  page->length += length;
+}
+
+/* appends a character */
+void page_putc(PAGE *page, char c)
+{
+  grow_page(page, 1);
+  page->data[page->length++] = c;
+}
+
+/* appends a string */
+void page_puts(PAGE *page, const char *text)
+{
+  page_write(page, text, strlen(text));
+}
+
+/* writes the page to a file */
+bool page_save(const PAGE *page, const char *filename)
+{
+  return save_data(filename, "", page->data, page->length, false);
+}
+
+/* writes the page compressed with brotli beside the page, with .br added to the filename */
+bool page_save_brotli(const PAGE *page, const char *filename)
+{
+  PAGE compressed;
+  bool saved;
+
+  if(!page_brotli(page, &compressed)) {
+    return false;
+  }
+
+  saved = save_data(filename, ".br", compressed.data, compressed.length, true);
+  page_free(&compressed);
+
+  return saved;
+}
+
+/* writes the page compressed with gzip beside the page, with .gz added to the filename */
+bool page_save_gzip(const PAGE *page, const char *filename)
+{
+  PAGE compressed;
+  bool saved;
+
+  if(!page_gzip(page, &compressed)) {
+    return false;
+  }
+
+  saved = save_data(filename, ".gz", compressed.data, compressed.length, true);
+  page_free(&compressed);
+
+  return saved;
+}
+
+/* appends length bytes of text */
+void page_write(PAGE *page, const char *text, size_t length)
+{
+  grow_page(page, length);
+  memcpy(page->data + page->length, text, length);
+  page->length += length;
+}
+
+/* makes room for length more bytes, at least doubling the buffer when it grows */
+void grow_page(PAGE *page, size_t length)
+{
+  if(page->length + length <= page->size) {
+    return;
+  }
+
+  while(page->length + length > page->size) {
+    page->size *= 2;
+  }
+
+  page->data = (char*)realloc((void*)page->data, page->size);
+}
+
+/* writes data to the file named filename followed by suffix, in one write where the
+   system allows. windows writes text in text mode as the pages always have been */
+bool save_data(const char *filename, const char *suffix, const char *data, size_t length, bool binary)
+{
+#ifndef WINDOWS
+  int file;
+  ssize_t written;
+  size_t offset;
+#else
+  FILE *file;
+#endif
+  char *path;
+  bool saved;
+
+  path = (char*)calloc(strlen(filename) + strlen(suffix) + 1, sizeof(char));
+  strcpy(path, filename);
+  strcat(path, suffix);
+
+#ifndef WINDOWS
+  /* the whole page is in memory so stdio's buffering would only add a copy */
+  file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  free((void*)path);
+
+  if(file == -1) {
+    return false;
+  }
+
+  saved = true;
+  for(offset = 0; saved && offset < length; offset += written) {
+    written = write(file, data + offset, length - offset);
+    saved = (written > 0);
+  }
+
+  return !close(file) && saved;
+#else
+  file = fopen(path, binary ? "wb" : "w");
+  free((void*)path);
+
+  if(file == NULL) {
+    return false;
+  }
+
+  saved = (fwrite(data, sizeof(char), length, file) == length);
+
+  return !fclose(file) && saved;
+#endif
+}
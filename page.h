@@ -0,0 +1,50 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _PAGE_H_
+#define _PAGE_H_
+
+#include <stddef.h>
+
+#include "bool.h"
+
+/* a page being rendered, it is built up in memory and then written out in one go */
+typedef struct {
+  char *data;
+  size_t length;
+  size_t size;
+} PAGE;
+
+/*** Function prototypes ***/
+
+bool page_brotli(const PAGE *page, PAGE *compressed); /** Compresses the page with brotli into a new page, false on failure or without brotli */
+bool page_brotli_available(void); /** Returns whether brotli was built in */
+void page_free(PAGE *page); /** Frees the text of the page */
+bool page_gzip(const PAGE *page, PAGE *compressed); /** Compresses the page with gzip into a new page, false on failure */
+void page_init(PAGE *page); /** Starts an empty page */
+void page_printf(PAGE *page, const char *format, ...); /** Appends formatted text, behaves as fprintf */
+void page_putc(PAGE *page, char c); /** Appends a character */
+void page_puts(PAGE *page, const char *text); /** Appends a string, behaves as fputs */
+bool page_save(const PAGE *page, const char *filename); /** Writes the page to a file, false on failure */
+bool page_save_brotli(const PAGE *page, const char *filename); /** Writes the page compressed with brotli to filename.br, false on failure or without brotli */
+bool page_save_gzip(const PAGE *page, const char *filename); /** Writes the page compressed with gzip to filename.gz, false on failure */
+void page_write(PAGE *page, const char *text, size_t length); /** Appends length bytes of text */
+
+#endif
@@ -26,8 +26,23 @@
 #include <string.h>
 #include <sys/stat.h>
 
+#ifdef WINDOWS
+#include <direct.h>
+#endif
+
+#include "bstrlib.h"
 #include "chess.h"
+#include "copy.h"
+#include "index.h"
+#include "input.h"
+#include "lexer.h"
+#include "manifest.h"
 #include "nag.h"
+#include "page.h"
+#include "pool.h"
+#include "tags.h"
+#include "template.h"
+#include "writer.h"
 
 /* define constant for system dependent file seperator */
 #ifdef WINDOWS
@@ -51,10 +66,54 @@ typedef struct variation {
   POSITION previous_position;
 
   int id;
-  char *buffer;
-  unsigned long int buffer_size;
+  bstring buffer; /* the variation's moves as javascript */
 } VARIATION;
 
+/* settings shared by all the games of a conversion, and what is kept from one
+   conversion to the next */
+struct converter {
+  char *html_filename; /* of the last conversion */
+  char *pieces;
+  char *images; /* where the piece images are copied from */
+  bool images_copied; /* beside the current output */
+  const char *game_list;
+  bool credit;
+  STRUCTURE layout;
+  int options;
+  bool list_entries;
+
+  TEMPLATE *template; /* shared by the workers, it is only read */
+  TEMPLATE *board, *frame; /* frameset layout only */
+  POOL *pool; /* NULL if converting one game at a time */
+  int workers;
+  WRITER **writers; /* one for each worker, NULL if the pages are saved directly */
+
+  bool shared_list;
+  char *script_filename, *script_tag;
+
+  char *manifest_path; /* when updating */
+  MANIFEST *manifest; /* of the last conversion */
+
+  P2W_SINK sink; /* receives the pages of an in-memory conversion, NULL to write files */
+  void *sink_context;
+
+  P2W_ERROR warning; /* a problem which didn't stop the last conversion */
+};
+
+/* a game handed to the worker pool */
+typedef struct {
+  const CONVERTER *converter;
+  INPUT pgn; /* view of the game's text */
+  int game;
+
+  INDEX_ENTRY *entry; /* receives the game's tags, NULL if they are already known */
+  bool changed; /* false if the page is up to date */
+  P2W_ERROR error; /* set by the worker */
+} GAME_JOB;
+
+/* games in each subdirectory of sharded pages */
+#define SHARD_SIZE 1000
+
 /* constants */
 const char *piece_filenames[] = {"", "wp", "wn", "wb", "wr", "wq", "wk", "bp", "bn", "bb", "br", "bq", "bk"};
 const char *credit_html = "This page was created with <a href=\"http://pgn2web.sourceforge.net\" target=\"_top\">pgn2web</a>.";
@@ -65,36 +124,168 @@ const char *game_template = "templates" SEPERATOR_STRING "game.html";
 const char *single_template = "templates" SEPERATOR_STRING "single.html";
 
 /* function prototypes */
-void append_move(char *string, const MOVE *move, const POSITION *position);
-void create_board(const char *board_filename, const char *html_filename, const char *pieces, const char *game_list, bool credit);
-void create_frame(const char* frame_filename, const char* html_filename); 
-void delete_variation(VARIATION *variation, char **moves, long int *moves_size);
+void append_game_list(char **game_list, unsigned long int *buffer_size, const CONVERTER *converter, int game, const char *white, const char *black, const char *date);
+void append_comment(bstring notation, const char *text, size_t length);
+void append_move(bstring string, const MOVE *move, const POSITION *position);
+void change_output(CONVERTER *converter, const char *html_filename);
+void convert_game_task(void *argument, int worker);
+P2W_ERROR convert_input(CONVERTER *converter, INPUT *pgn, const char *pgn_filename, void (*progress)(float percentage, void *context), void *progress_context);
+P2W_ERROR create_board(const CONVERTER *converter, WRITER *writer, const char *game_list);
+P2W_ERROR create_frame(const CONVERTER *converter, WRITER *writer);
+P2W_ERROR create_game_list_script(const CONVERTER *converter, WRITER *writer, const char *game_list);
+void delete_variation(VARIATION *variation, bstring moves);
 MOVE extract_coordinates(const char* algebraic);
-int extract_game_list(FILE* file, const char* html_filename, char** game_list); /* !! allocates memory which must be freed by caller !! */
+int extract_game_list(INPUT* pgn, const PGN_INDEX *index, const CONVERTER *converter, char** game_list); /* !! allocates memory which must be freed by caller !! */
 void filecat(char *filename, const char *suffix);
+P2W_ERROR flush_writers(const CONVERTER *converter, P2W_ERROR error);
+void free_writers(CONVERTER *converter);
+void game_list_script_filename(char *filename);
+void game_page_filename(char *filename, int game, bool sharded, char seperator);
+void make_shard_directory(const CONVERTER *converter, int shard);
+bool page_exists(const CONVERTER *converter, const char *filename);
 void pathcat(char *root_path, const char *path);
 void print_board(FILE* html, const char* FEN);
-void print_initial_position(FILE* file, const char* FEN, const char* var);
-void process_game(FILE *pgn, FILE *template, const char *html_filename, const int game, const char *pieces, const char* game_list, bool credit, STRUCTURE layout);
-void process_moves(FILE* pgn, const char* FEN, char **moves, char **notation, STRUCTURE layout); /* !! allocates memory which must be freed by caller !! */
-void strip(FILE *pgn);
+void print_initial_position(PAGE* page, const char* FEN, const char* var);
+P2W_ERROR process_game(const CONVERTER *converter, WRITER *writer, INPUT *pgn, const int game, INDEX_ENTRY *entry, bool changed);
+void process_moves(INPUT* pgn, const char* FEN, bstring *moves, bstring *notation, STRUCTURE layout); /* !! allocates memory which must be freed by caller !! */
+void record_tag(INDEX_ENTRY *entry, int tag, const char *value);
+void report_progress(const PGN_INDEX *index, const INPUT *pgn, size_t game, void (*progress)(float percentage, void *context), void *progress_context);
 void truncate_to_path(char *filename);
 void truncate_to_filename(char *filename);
+P2W_ERROR write_page(const CONVERTER *converter, WRITER *writer, const char *filename, PAGE *page);
 
 /* main function */
 
 int pgn2web(const char* resource_path, const char *pgn_filename, const char *html_filename,
-	    bool credit, const char *pieces, STRUCTURE layout,
+	    bool credit, const char *pieces, STRUCTURE layout, int options, int jobs,
 	    void (*progress)(float percentage, void *context), void *progress_context)
+{
+  return pgn2web_watch(resource_path, pgn_filename, html_filename, credit, pieces, layout, options, jobs,
+		       progress, progress_context, NULL, NULL);
+}
+
+/* converts a pgn file to the given output, any number may be converted with the same converter */
+P2W_ERROR pgn2web_convert(CONVERTER *converter, const char *pgn_filename, const char *html_filename,
+			  void (*progress)(float percentage, void *context), void *progress_context)
+{
+  INPUT *pgn;
+  P2W_ERROR error;
+
+  change_output(converter, html_filename);
+
+  /* copy the images beside the pages, once for each output */
+  if(!converter->images_copied && !(converter->options & NO_IMAGE_COPY)) {
+    if((error = pgn2web_copy_images(converter, html_filename)) != P2W_OK) {
+      return error;
+    }
+    converter->images_copied = true;
+  }
+
+  /* open pgn file */
+  pgn = (converter->options & SNAPSHOT_PGN) ? input_read(pgn_filename) : input_open(pgn_filename);
+  if(pgn == NULL) {
+    return P2W_PGN_ERROR;
+  }
+
+  converter->sink = NULL;
+  converter->sink_context = NULL;
+
+  error = convert_input(converter, pgn, pgn_filename, progress, progress_context);
+
+  /* close files */
+  input_close(pgn);
+
+  return error;
+}
+
+/* converts a pgn held in memory, handing each page to the sink rather than writing files.
+   html_filename only names the pages and the links between them */
+P2W_ERROR pgn2web_convert_buffer(CONVERTER *converter, const char *pgn_data, size_t length, const char *html_filename,
+				 P2W_SINK sink, void *sink_context,
+				 void (*progress)(float percentage, void *context), void *progress_context)
+{
+  INPUT pgn;
+  P2W_ERROR error;
+
+  change_output(converter, html_filename);
+
+  /* the buffer stays the caller's, so the input is never closed */
+  memset(&pgn, 0, sizeof(INPUT));
+  pgn.data = pgn_data;
+  pgn.length = length;
+
+  converter->sink = sink;
+  converter->sink_context = sink_context;
+
+  error = convert_input(converter, &pgn, NULL, progress, progress_context);
+
+  converter->sink = NULL;
+  converter->sink_context = NULL;
+
+  return error;
+}
+
+/* copies the piece images into the directory the pages are written to */
+P2W_ERROR pgn2web_copy_images(CONVERTER *converter, const char *html_filename)
+{
+#ifdef WINDOWS
+  char *command;
+#endif
+  char *dest;
+
+  /* create destination path for the copy */
+  dest = (char*)calloc(strlen(html_filename) + strlen(converter->pieces) + 2, sizeof(char));
+  strcpy(dest, html_filename);
+  truncate_to_path(dest);
+  pathcat(dest, converter->pieces);
+
+#ifdef WINDOWS
+  /* allocate required space for command string */
+
+  command = (char*)calloc(strlen(converter->images) + strlen(dest) + 32, sizeof(char));
+
+  strcpy(command, "MD \"");
+  strcat(command, dest);
+  strcat(command, "\"");
+  system(command);
+
+  strcpy(command, "COPY \"");
+  strcat(command, converter->images);
+  strcat(command, "\" \"");
+  strcat(command, dest);
+  strcat(command, "\"");
+  system(command);
+
+  free((void*)command);
+#else
+  /* copy in process, leaving images which are already up to date */
+  if(!copy_directory(converter->images, dest)) {
+    free((void*)dest);
+    return P2W_IMAGES_ERROR;
+  }
+#endif
+
+  free((void*)dest);
+
+  return P2W_OK;
+}
+
+/* sets up a converter, compiling the templates and starting the workers */
+P2W_ERROR pgn2web_create(CONVERTER **converter, const char *resource_path, bool credit, const char *pieces,
+			 STRUCTURE layout, int options, int jobs)
 {
   char *board_filename, *frame_filename, *game_filename, *single_filename;
   char *template_filename;
-  char *command, *src, *dest;
-  FILE *pgn, *template;
-  char *game_list;
-  int game = 0;
-  int games;
-  char test;
+  int worker;
+  P2W_ERROR error = P2W_OK;
+
+  *converter = (CONVERTER*)calloc(1, sizeof(CONVERTER));
+  (*converter)->credit = credit;
+  (*converter)->layout = layout;
+  (*converter)->options = options;
+
+  (*converter)->pieces = (char*)calloc(strlen(pieces) + 1, sizeof(char));
+  strcpy((*converter)->pieces, pieces);
 
   /* create full paths for template files */
   board_filename = (char*)calloc(strlen(resource_path) + strlen(board_template) + 2,
@@ -117,114 +308,220 @@ int pgn2web(const char* resource_path, const char *pgn_filename, const char *htm
   strcpy(single_filename, resource_path);
   pathcat(single_filename, single_template);
 
-  /* open pgn file */
-  if((pgn = fopen(pgn_filename, "r")) == NULL) {
-    exit(1);
+  /* select the right template file */
+  template_filename = (layout == FRAMESET) ? game_filename : single_filename;
+
+  /* without brotli every page would fail once written, so refuse before any are */
+  if((options & BROTLI_PAGES) && !page_brotli_available()) {
+    error = P2W_COMPRESSION_ERROR;
+  }
+  /* the templates are compiled once for every game */
+  else if(((*converter)->template = template_compile(template_filename)) == NULL) {
+    error = P2W_TEMPLATE_ERROR;
+  }
+  else if(layout == FRAMESET) {
+    if(((*converter)->board = template_compile(board_filename)) == NULL ||
+       ((*converter)->frame = template_compile(frame_filename)) == NULL) {
+      error = P2W_TEMPLATE_ERROR;
+    }
   }
 
-  /* select and open the right template file */
-  template_filename = (layout == FRAMESET) ? game_filename : single_filename;
+  free((void*)board_filename);
+  free((void*)frame_filename);
+  free((void*)game_filename);
+  free((void*)single_filename);
 
-  if((template = fopen(template_filename, "r")) == NULL) {
-    perror("Unable to open template file");
-    exit(1);
+  if(error != P2W_OK) {
+    pgn2web_destroy(*converter);
+    *converter = NULL;
+    return error;
   }
 
-  /** copy images **/
-  
-  /* create source and destination paths for the copy */
+  /* the piece images are copied beside each output */
+  (*converter)->images = (char*)calloc(strlen(resource_path) + strlen("images") + strlen(pieces) + 3,
+				       sizeof(char));
+  strcpy((*converter)->images, resource_path);
+  pathcat((*converter)->images, "images");
+  pathcat((*converter)->images, pieces);
+
+  /* a shared game list is written to a script which the linked pages reference */
+  (*converter)->shared_list = (options & SHARED_GAME_LIST) && layout == LINKED;
+
+  /* with more than one job the games are converted by a pool of worker threads */
+  (*converter)->pool = (jobs > 1) ? pool_create(jobs) : NULL;
+  (*converter)->workers = (*converter)->pool ? pool_threads((*converter)->pool) : 1;
+
+  /* where io_uring is available each worker queues its pages to a writer of its own */
+  (*converter)->writers = (WRITER**)calloc((*converter)->workers, sizeof(WRITER*));
+  for(worker = 0; worker < (*converter)->workers; worker++) {
+    if(((*converter)->writers[worker] = writer_create()) == NULL) {
+      free_writers(*converter);
+      break;
+    }
+  }
 
-  src = (char*)calloc(strlen(resource_path) + strlen("images") + strlen(pieces) + 3,
-			 sizeof(char));
-  strcpy(src, resource_path);
-  pathcat(src, "images");
-  pathcat(src, pieces);
+  return P2W_OK;
+}
 
-  dest = (char*)calloc(strlen(html_filename) + strlen(pieces) + 2, sizeof(char));
-  strcpy(dest, html_filename);
-  truncate_to_path(dest);
-  pathcat(dest, pieces);
+/* frees a converter and what it kept between conversions */
+void pgn2web_destroy(CONVERTER *converter)
+{
+  if(converter->pool) {
+    pool_destroy(converter->pool);
+  }
 
-  /* allocate required space for command string */
+  free_writers(converter);
 
-  command = (char*)calloc(strlen(src) + strlen(dest) + 32, sizeof(char));
+  if(converter->template) {
+    template_free(converter->template);
+  }
+  if(converter->board) {
+    template_free(converter->board);
+  }
+  if(converter->frame) {
+    template_free(converter->frame);
+  }
 
-#ifdef WINDOWS
-  strcpy(command, "MD \"");
-  strcat(command, dest);
-  strcat(command, "\"");
-  system(command);
+  if(converter->manifest) {
+    manifest_free(converter->manifest);
+  }
 
-  strcpy(command, "COPY \"");
-  strcat(command, src);
-  strcat(command, "\" \"");
-  strcat(command, dest);
-  strcat(command, "\"");
-  system(command);
-#else
-  strcpy(command, "cp -r \"");
-  strcat(command, src);
-  strcat(command, "\" \"");
-  strcat(command, dest);
-  strcat(command, "\"");
-  system(command);
-#endif
+  free((void*)converter->html_filename);
+  free((void*)converter->pieces);
+  free((void*)converter->images);
+  free((void*)converter->script_filename);
+  free((void*)converter->script_tag);
+  free((void*)converter->manifest_path);
+  free((void*)converter);
+}
 
-  free((void*)src);
-  free((void*)dest);
-  free((void*)command);
+/* describes an error code */
+const char *pgn2web_error(P2W_ERROR error)
+{
+  switch(error) {
+  case P2W_OK:
+    return "Success";
+  case P2W_TEMPLATE_ERROR:
+    return "Unable to open template file";
+  case P2W_IMAGES_ERROR:
+    return "Unable to copy piece images";
+  case P2W_PGN_ERROR:
+    return "Unable to open pgn file";
+  case P2W_HTML_ERROR:
+    return "Unable to create html file";
+  case P2W_COMPRESSION_ERROR:
+    return "Unable to write compressed page";
+  case P2W_INDEX_ERROR:
+    return "Unable to write index file";
+  case P2W_MANIFEST_ERROR:
+    return "Unable to write manifest file";
+  }
+
+  return "Unknown error";
+}
 
-  /* extract game list */
-  games = extract_game_list(pgn, html_filename, &game_list); /* !! allocates memory to game_list, free after use !! */
-  rewind(pgn);
+/* a problem which didn't stop the last conversion, P2W_OK if there was none */
+P2W_ERROR pgn2web_warning(const CONVERTER *converter)
+{
+  return converter->warning;
+}
+
+/* converts the pgn, then again each time wait returns true, keeping the templates etc between conversions */
+int pgn2web_watch(const char* resource_path, const char *pgn_filename, const char *html_filename,
+		  bool credit, const char *pieces, STRUCTURE layout, int options, int jobs,
+		  void (*progress)(float percentage, void *context), void *progress_context,
+		  bool (*wait)(void *context), void *wait_context)
+{
+  CONVERTER *converter;
+  P2W_ERROR error;
 
-  /* if frameset layout then create board & frameset pages */
-  if(layout == FRAMESET) {
-    create_board(board_filename, html_filename, pieces, game_list, credit);
-    create_frame(frame_filename, html_filename);
+  if((error = pgn2web_create(&converter, resource_path, credit, pieces, layout,
+			      wait ? options | SNAPSHOT_PGN : options, jobs)) != P2W_OK) {
+    return error;
   }
 
-  /* skip any whitespace (or garbage) */
-  while((test = getc(pgn)) != '[' && test != EOF) {
+  /* a watched pgn may be missing for a moment while it is replaced */
+  do {
+    error = pgn2web_convert(converter, pgn_filename, html_filename, progress, progress_context);
+  } while(wait && (error == P2W_OK || error == P2W_PGN_ERROR) && (*wait)(wait_context));
+
+  /* the converter goes with this, so pass on any warning */
+  if(error == P2W_OK) {
+    error = converter->warning;
   }
-  ungetc(test, pgn);
 
-  /* process games */
-  while(!feof(pgn)) {
-    rewind(template); /* go back to start of template */
-  
-    /* process game */
-    process_game(pgn, template, html_filename, game, pieces, game_list, credit, layout);
-    game++;
+  pgn2web_destroy(converter);
 
-    /* call progress callback (for gui progress meters etc) */
-    if(progress) {
-      (*progress)((float)game * 100 / games, progress_context);
-    }
+  return error;
+}
 
-    /* skip remaining whitespace (and any garbage) */
-    while((test = getc(pgn)) != '[' && test != EOF) {
-    }
-    ungetc(test, pgn);
+/* appends an option for a game to the game list, enlarging the buffer as required */
+void append_game_list(char **game_list, unsigned long int *buffer_size, const CONVERTER *converter, int game, const char *white, const char *black, const char *date)
+{
+  bool sharded = (converter->options & SHARDED_PAGES) ? true : false;
+  char *url, *name;
+  unsigned long int length;
+
+  /* generate game url, from a linked page in a shard the other shards are beside its own */
+  url = (char*)calloc(strlen(converter->html_filename) + 64, sizeof(char));
+  if(sharded && converter->layout == LINKED) {
+    strcpy(url, "../");
   }
+  name = url + strlen(url);
+  strcpy(name, converter->html_filename);
+  truncate_to_filename(name);
+  game_page_filename(name, game, sharded, '/');
 
-  /* close files */
-  fclose(pgn);
-  fclose(template);
+#ifdef DEBUG
+  printf("(%s) %s - %s %s\n", url, white, black, date);
+#endif
 
-  /* free allocated memory */
-  free((void*)board_filename);
-  free((void*)frame_filename);
-  free((void*)game_filename);
-  free((void*)single_filename);
-  free((void*)game_list);
+  /* don't display date if it is unknown */
+  if(!strcmp(date, "????.??.??")) {
+    date = "";
+  }
+
+  /* allocate more memory if buffer is running low */
+  length = strlen(*game_list);
+  if(length + strlen(url) + strlen(white) + strlen(black) + strlen(date) + 32 > *buffer_size) {
+    *buffer_size = (*buffer_size + strlen(url) + strlen(white) + strlen(black) + strlen(date) + 32) * 2;
+    *game_list = (char*)realloc((void*)*game_list, *buffer_size);
+  }
+
+  /* generate html for option list */
+  sprintf(*game_list + length, "<option value=\"%s\">%s - %s %s\n", url, white, black, date);
 
-  /* sucess! */
-  return 0;
+  free((void*)url);
+}
+
+/* appends a comment to the notation a word at a time, each after a space as the comment's
+   own layout means nothing in html. the last word is always followed by the closing brace */
+void append_comment(bstring notation, const char *text, size_t length)
+{
+  const char *end = text + length;
+  const char *word;
+
+  for(;;) {
+    for(word = text; text < end && !isspace((unsigned char)*text); text++) {
+    }
+
+    if(text > word || text == end) {
+      bconchar(notation, ' ');
+      bcatblk(notation, word, text - word);
+    }
+
+    if(text == end) {
+      break;
+    }
+
+    while(text < end && isspace((unsigned char)*text)) {
+      text++;
+    }
+  }
 }
 
 /* append to string move as javascript data */
-void append_move(char *string, const MOVE *move, const POSITION *position)
+void append_move(bstring string, const MOVE *move, const POSITION *position)
 {
   /* special moves must be broken down into 2 moves for simple javascript code e.g. castling requires moving two pieces */
   int js_move[4] = {-1, -1, -1, -1};
@@ -270,81 +567,371 @@ void append_move(char *string, const MOVE *move, const POSITION *position)
   }
 
   /* now write javascript move to string */
-  sprintf(string + strlen(string), "%d,%d,%d,%d,", js_move[0], js_move[1], js_move[2], js_move[3]);
+  bformata(string, "%d,%d,%d,%d,", js_move[0], js_move[1], js_move[2], js_move[3]);
 }
 
-/* creates board child frame from template */
-void create_board(const char* template_filename, const char *html_filename, const char* pieces, const char* game_list, bool credit)
+/* points the converter at a new output, the images must be copied again */
+void change_output(CONVERTER *converter, const char *html_filename)
 {
-  char *board_filename;
-  char buffer[256];
-  char *tag;
-  FILE *template, *board;
+  char *script_url, *name;
 
-  /* generate board filename */
-  board_filename = (char*)calloc(strlen(html_filename) + strlen(".board") + 1, sizeof(char));
-  strcpy(board_filename, html_filename);
-  filecat(board_filename, ".board");
+  /* nothing to do when converting to the same output again */
+  if(converter->html_filename && !strcmp(converter->html_filename, html_filename)) {
+    return;
+  }
 
-  /* open template and output file */
-  if((template = fopen(template_filename, "r")) == NULL) {
-    perror("Unable to open template file");
-    exit(1);
+  free((void*)converter->html_filename);
+  converter->html_filename = (char*)calloc(strlen(html_filename) + 1, sizeof(char));
+  strcpy(converter->html_filename, html_filename);
+  converter->images_copied = false;
+
+  /* the linked pages reference the shared game list script by its name */
+  if(converter->shared_list) {
+    free((void*)converter->script_filename);
+    converter->script_filename = (char*)calloc(strlen(html_filename) + strlen(".games.js") + 1, sizeof(char));
+    strcpy(converter->script_filename, html_filename);
+    game_list_script_filename(converter->script_filename);
+
+    /* sharded pages are a directory below the script */
+    script_url = (char*)calloc(strlen(converter->script_filename) + 4, sizeof(char));
+    if(converter->options & SHARDED_PAGES) {
+      strcpy(script_url, "../");
+    }
+    name = script_url + strlen(script_url);
+    strcpy(name, converter->script_filename);
+    truncate_to_filename(name);
+
+    free((void*)converter->script_tag);
+    converter->script_tag = (char*)calloc(strlen(script_url) + 128, sizeof(char));
+    sprintf(converter->script_tag, "<script language=\"javascript\" type=\"text/javascript\" src=\"%s\"></script>\n", script_url);
+    free((void*)script_url);
   }
-  if((board = fopen(board_filename, "w")) == NULL) {
-    perror("Unable to create html file");
-    exit(1);
+
+  /* an update keeps a manifest of what the pages were made from, the last one is for another output */
+  if(converter->options & INCREMENTAL) {
+    free((void*)converter->manifest_path);
+    converter->manifest_path = (char*)calloc(strlen(html_filename) + strlen(".manifest") + 1, sizeof(char));
+    strcpy(converter->manifest_path, html_filename);
+    manifest_filename(converter->manifest_path);
+
+    if(converter->manifest) {
+      manifest_free(converter->manifest);
+      converter->manifest = NULL;
+    }
   }
+}
 
-  free((void*)board_filename);
+/* converts one game of a batch on a worker thread */
+void convert_game_task(void *argument, int worker)
+{
+  GAME_JOB *job = (GAME_JOB*)argument;
+  const CONVERTER *converter = job->converter;
+  WRITER *writer = converter->writers ? converter->writers[worker] : NULL;
+
+  job->error = process_game(converter, writer, &job->pgn, job->game, job->entry, job->changed);
+}
 
-  /* process template file, replacing XML-like tags */
-  while(fgets(buffer, 256, template) != NULL) {
+/* converts the pgn to the current output, rewriting only what is needed when updating */
+P2W_ERROR convert_input(CONVERTER *converter, INPUT *pgn, const char *pgn_filename,
+			void (*progress)(float percentage, void *context), void *progress_context)
+{
+  const char *html_filename = converter->html_filename;
+  const char *pieces = converter->pieces;
+  bool credit = converter->credit;
+  STRUCTURE layout = converter->layout;
+  int options = converter->options;
+  char *game_list = NULL;
+  unsigned long int game_list_size;
+  bool single_pass;
+  size_t game = 0;
+  size_t games;
+  char *pgi_filename;
+  PGN_INDEX *index = NULL;
+  INDEX_ENTRY *entry;
+  bool indexed, append;
+  GAME_JOB *batch;
+  MANIFEST *manifest, *old_manifest;
+  unsigned long long settings;
+  bool list_changed;
+  int batch_size, count, job;
+  int compressed = options & (GZIP_PAGES | BROTLI_PAGES);
+  bool sharded = (options & SHARDED_PAGES) ? true : false;
+  int shard = -1;
+  WRITER *writer = converter->writers ? converter->writers[0] : NULL; /* for the list pages, the workers are idle by then */
+  P2W_ERROR error = P2W_OK;
+
+  converter->warning = P2W_OK;
+
+  /* reuse the sidecar index if it still matches the pgn (a pipe or buffer can't have one),
+     when appending it also covers the games before any that have been added */
+  pgi_filename = NULL;
+  append = false;
+
+  if((options & SIDECAR_INDEX) && pgn_filename && pgn->mtime) {
+    pgi_filename = (char*)calloc(strlen(pgn_filename) + strlen(".pgi") + 1, sizeof(char));
+    strcpy(pgi_filename, pgn_filename);
+    index_filename(pgi_filename);
+
+    append = (options & APPEND) ? true : false;
+    index = index_load(pgi_filename, pgn, append);
+  }
 
-    if(!strstr(buffer, "/>")) {
-      fprintf(board, "%s", buffer);
-      continue;
+  /* otherwise find where each game starts and ends */
+  if(index == NULL) {
+    index = index_scan(pgn, pgi_filename != NULL); /* !! allocates memory to index, free after use !! */
+  }
+
+  games = index->games;
+  indexed = (index->known == games); /* the index already holds the tags of every game */
+
+  /* an embedded linked game list goes in every page so it must be known up front,
+     otherwise the list is built as the games are converted in a single pass */
+  single_pass = (layout != LINKED || converter->shared_list);
+
+  if(single_pass || indexed) {
+    game_list_size = 4096;
+    game_list = (char*)calloc(game_list_size, sizeof(char));
+  }
+
+  if(indexed) {
+    for(game = 0; game < games; game++) {
+      entry = &index->entries[game];
+      if(*entry->tags[TAG_WHITE] && *entry->tags[TAG_BLACK]) {
+	append_game_list(&game_list, &game_list_size, converter, game,
+			 entry->tags[TAG_WHITE], entry->tags[TAG_BLACK], entry->tags[TAG_DATE]);
+      }
+    }
+    game = 0;
+  }
+  else if(!single_pass) {
+    /* extract game list */
+    extract_game_list(pgn, index, converter, &game_list); /* !! allocates memory to game_list, free after use !! */
+    input_rewind(pgn);
+  }
+
+  converter->game_list = single_pass ? converter->script_tag : game_list;
+  converter->list_entries = single_pass && !indexed && layout != INDIVIDUAL;
+
+  /* an update only rewrites the pages whose game, template or options have changed since
+     the last conversion, the others are left alone to keep their modification times */
+  manifest = old_manifest = NULL;
+  settings = MANIFEST_SEED;
+
+  if((options & INCREMENTAL) && !converter->sink) {
+    /* the manifest of the last conversion to this output is kept */
+    old_manifest = converter->manifest ? converter->manifest : manifest_load(converter->manifest_path);
+    converter->manifest = NULL;
+    manifest = manifest_create(games);
+
+    settings = manifest_hash(settings, converter->template->file->data, converter->template->file->length);
+    settings = manifest_hash(settings, html_filename, strlen(html_filename));
+    settings = manifest_hash(settings, pieces, strlen(pieces));
+    settings = manifest_hash(settings, &credit, sizeof(credit));
+    settings = manifest_hash(settings, &layout, sizeof(layout));
+    settings = manifest_hash(settings, &compressed, sizeof(compressed));
+    settings = manifest_hash(settings, &sharded, sizeof(sharded));
+    if(converter->game_list) {
+      settings = manifest_hash(settings, converter->game_list, strlen(converter->game_list));
+    }
+  }
+
+  batch_size = converter->workers * 64;
+  batch = (GAME_JOB*)calloc(batch_size, sizeof(GAME_JOB));
+
+  /* show where the conversion starts, which may be part way through when appending */
+  if(progress && game < games) {
+    report_progress(index, pgn, game, progress, progress_context);
+  }
+
+  /* process games, stopping at the first batch with a page that can't be written */
+  while(game < games && error == P2W_OK) {
+
+    /* queue up the next batch of games */
+    for(count = 0; count < batch_size && game < games; count++, game++) {
+      batch[count].converter = converter;
+
+      /* the workers write into a shard's directory once the first of its games is reached */
+      if(sharded && !converter->sink && (int)game / SHARD_SIZE != shard) {
+	shard = game / SHARD_SIZE;
+	make_shard_directory(converter, shard);
+      }
+
+      entry = &index->entries[game];
+      input_view(&batch[count].pgn, pgn, entry->offset, entry->offset + entry->length);
+      batch[count].game = game;
+      batch[count].entry = (game < index->known) ? NULL : entry;
+      batch[count].changed = true;
+
+      if(manifest) {
+	manifest->pages[game] = manifest_hash(settings, pgn->data + entry->offset, entry->length);
+	batch[count].changed = (!old_manifest || game >= old_manifest->games ||
+				old_manifest->pages[game] != manifest->pages[game]);
+      }
+      else if(append && single_pass && game < index->known) {
+	/* the game is as it was, and its page doesn't hold the game list */
+	batch[count].changed = false;
+      }
+
+      if(converter->pool) {
+	pool_submit(converter->pool, convert_game_task, &batch[count]);
+      }
+      else {
+	convert_game_task(&batch[count], 0);
+      }
+    }
+
+    if(converter->pool) {
+      pool_wait(converter->pool);
     }
-	  
-    if((tag = strstr(buffer, "<credit/>"))) {
-      *tag = '\0';
-      fprintf(board, "%s", buffer);
-      if(credit) {
-        fprintf(board, credit_html);
+
+    for(job = 0; job < count; job++) {
+      if(batch[job].error != P2W_OK) {
+	error = batch[job].error;
       }
-      fprintf(board, "%s", tag + strlen("<credit/>"));
     }
 
-    if((tag = strstr(buffer, "<pieces/>"))) {
-      *tag = '\0';
-      fprintf(board, "%s", buffer);
-      fprintf(board, pieces);
-      fprintf(board, "%s", tag + strlen("<pieces/>"));
+    /* the batch is only done once its pages are written */
+    error = flush_writers(converter, error);
+
+    /* when converting in a single pass add the games to the list in order */
+    for(job = 0; converter->list_entries && job < count; job++) {
+      entry = &index->entries[batch[job].game];
+      if(*entry->tags[TAG_WHITE] && *entry->tags[TAG_BLACK]) {
+	append_game_list(&game_list, &game_list_size, converter, batch[job].game,
+			 entry->tags[TAG_WHITE], entry->tags[TAG_BLACK], entry->tags[TAG_DATE]);
+      }
+    }
+
+    /* call progress callback (for gui progress meters etc) */
+    if(progress) {
+      report_progress(index, pgn, game, progress, progress_context);
     }
+  }
 
+  free((void*)batch);
 
-    if(strstr(buffer, "<gamelist/>")) {
-	fprintf(board, "<select name=\"game\" onchange=\"if(this.value != 'null') parent.game.location=this.value;\">\n");
-	fprintf(board, "<option value=\"null\">Select a game...\n");
-	fprintf(board, "%s", game_list);
-	fprintf(board, "</select>\n");
+  /* save the index for next time, if every game was read */
+  if(pgi_filename) {
+    if(error == P2W_OK && index->known < games && !index_save(index, pgi_filename)) {
+      converter->warning = P2W_INDEX_ERROR;
     }
+    free((void*)pgi_filename);
   }
+  index_free(index);
 
-  /* close files */
-  fclose(template);
-  fclose(board);
+  /* the game list pages only change with the list, or the templates and options */
+  list_changed = true;
+
+  if(manifest) {
+    manifest->list = manifest_hash(settings, game_list, strlen(game_list));
+    if(layout == FRAMESET) {
+      manifest->list = manifest_hash(manifest->list, converter->board->file->data, converter->board->file->length);
+      manifest->list = manifest_hash(manifest->list, converter->frame->file->data, converter->frame->file->length);
+    }
+
+    list_changed = (!old_manifest || old_manifest->list != manifest->list ||
+		    (layout == FRAMESET && !page_exists(converter, html_filename)) ||
+		    (converter->shared_list && !page_exists(converter, converter->script_filename)));
+  }
+
+  /* if frameset layout then create board & frameset pages, now that the game list is complete */
+  if(error == P2W_OK && layout == FRAMESET && list_changed) {
+    if((error = create_board(converter, writer, game_list)) == P2W_OK) {
+      error = create_frame(converter, writer);
+    }
+  }
+
+  /* write the shared game list */
+  if(error == P2W_OK && converter->shared_list && list_changed) {
+    error = create_game_list_script(converter, writer, game_list);
+  }
+
+  error = flush_writers(converter, error);
+
+  /* save the manifest for the next update, unless some pages weren't written */
+  if(manifest) {
+    if(error == P2W_OK) {
+      if(!manifest_save(manifest, converter->manifest_path)) {
+	converter->warning = P2W_MANIFEST_ERROR;
+      }
+      converter->manifest = manifest;
+    }
+    else {
+      manifest_free(manifest);
+    }
+    if(old_manifest) {
+      manifest_free(old_manifest);
+    }
+  }
+
+  /* free allocated memory */
+  free((void*)game_list);
+
+  return error;
 }
 
-void create_frame(const char *frame_filename, const char *html_filename)
+/* creates board child frame from template */
+P2W_ERROR create_board(const CONVERTER *converter, WRITER *writer, const char *game_list)
 {
+  const TEMPLATE *template = converter->board;
+  char *board_filename;
+  const SEGMENT *segment;
+  PAGE board;
+  P2W_ERROR error;
+
+  /* generate board filename */
+  board_filename = (char*)calloc(strlen(converter->html_filename) + strlen(".board") + 1, sizeof(char));
+  strcpy(board_filename, converter->html_filename);
+  filecat(board_filename, ".board");
+
+  page_init(&board);
+
+  /* render the template, replacing XML-like tags */
+  for(segment = template->segments; segment < template->segments + template->count; segment++) {
+    switch(segment->type) {
+    case SEGMENT_LITERAL:
+      page_write(&board, segment->text, segment->length);
+      break;
+    case SEGMENT_CREDIT:
+      if(converter->credit) {
+	page_puts(&board, credit_html);
+      }
+      break;
+    case SEGMENT_GAMELIST:
+      page_puts(&board, "<select name=\"game\" onchange=\"if(this.value != 'null') parent.game.location=this.value;\">\n");
+      page_puts(&board, "<option value=\"null\">Select a game...\n");
+      page_puts(&board, game_list);
+      page_puts(&board, "</select>\n");
+      break;
+    case SEGMENT_PIECES:
+      page_puts(&board, converter->pieces);
+      break;
+    default:
+      break;
+    }
+  }
+
+  /* write the page out */
+  error = write_page(converter, writer, board_filename, &board);
+
+  page_free(&board);
+  free((void*)board_filename);
+
+  return error;
+}
+
+P2W_ERROR create_frame(const CONVERTER *converter, WRITER *writer)
+{
+  const TEMPLATE *template = converter->frame;
+  const char *html_filename = converter->html_filename;
   char *board_url, *game_url;
-  FILE *template, *frame;
-  char buffer[256];
+  const SEGMENT *segment;
+  PAGE frame;
+  P2W_ERROR error;
   
   /* allocate memory */
   board_url = (char*)calloc(strlen(html_filename) + strlen(".board") + 1, sizeof(char));
-  game_url = (char*)calloc(strlen(html_filename) + 2, sizeof(char));
+  game_url = (char*)calloc(strlen(html_filename) + 64, sizeof(char));
   
   /* generate filenames */
   strcpy(board_url, html_filename);
@@ -353,77 +940,108 @@ void create_frame(const char *frame_filename, const char *html_filename)
 
   strcpy(game_url, html_filename);
   truncate_to_filename(game_url);
-  filecat(game_url, "0");
+  game_page_filename(game_url, 0, (converter->options & SHARDED_PAGES) ? true : false, '/');
 
-  /* open template and output file */
-  if((template = fopen(frame_filename, "r")) == NULL) {
-    perror("Unable to open template file");
-    exit(1);
-  }
-  if((frame = fopen(html_filename, "w")) == NULL) {
-    perror("Unable to create html file");
-    exit(1);
-  }
+  page_init(&frame);
 
-  /* process template file, replacing XML-like tags */
-  while(fgets(buffer, 256, template) != NULL) {
-    if(strstr(buffer, "/>") == NULL) {
-      fprintf(frame, "%s", buffer);
-    }
-    else {
-      if(strstr(buffer, "<board/>")) {
-	fprintf(frame, "<frame name=\"board\" src=\"%s\">\n", board_url);
-      }
-      if(strstr(buffer, "<game/>")) {
-	fprintf(frame, "<frame name=\"game\" src=\"%s\">\n", game_url);
-      }
+  /* render the template, replacing XML-like tags */
+  for(segment = template->segments; segment < template->segments + template->count; segment++) {
+    switch(segment->type) {
+    case SEGMENT_LITERAL:
+      page_write(&frame, segment->text, segment->length);
+      break;
+    case SEGMENT_BOARD:
+      page_printf(&frame, "<frame name=\"board\" src=\"%s\">\n", board_url);
+      break;
+    case SEGMENT_GAME:
+      page_printf(&frame, "<frame name=\"game\" src=\"%s\">\n", game_url);
+      break;
+    default:
+      break;
     }
   }
 
-  /* close files & free memory*/
+  /* write the page out & free memory */
+  error = write_page(converter, writer, html_filename, &frame);
+
+  page_free(&frame);
   free((void*)board_url);
   free((void*)game_url);
-  fclose(template);
-  fclose(frame);
+
+  return error;
+}
+
+/* writes the game list to a script which adds the options to the enclosing select */
+P2W_ERROR create_game_list_script(const CONVERTER *converter, WRITER *writer, const char *game_list)
+{
+  PAGE script;
+  const char *c;
+  P2W_ERROR error;
+
+  page_init(&script);
+
+  /* one document.write per option, escaping the text as a javascript string */
+  for(c = game_list; *c; c++) {
+    if(c == game_list || *(c - 1) == '\n') {
+      page_puts(&script, "document.write('");
+    }
+
+    switch(*c) {
+    case '\\':
+      page_puts(&script, "\\\\");
+      break;
+    case '\'':
+      page_puts(&script, "\\'");
+      break;
+    case '\r':
+      break;
+    case '\n':
+      page_puts(&script, "\\n');\n");
+      break;
+    default:
+      page_putc(&script, *c);
+    }
+  }
+
+  error = write_page(converter, writer, converter->script_filename, &script);
+  page_free(&script);
+
+  return error;
 }
 
 /* deletes a variation adding its data to the moves string */
-void delete_variation(VARIATION *variation, char **moves, long int *moves_size)
+void delete_variation(VARIATION *variation, bstring moves)
 {
   /* add parent information to moves */
 #ifdef DEBUG
   printf("Adding moves: %d\n", variation->id);
-  printf("%s\n", variation->buffer);
+  printf("%s\n", bdata(variation->buffer));
 #endif
 
-  *moves_size += 64;
-  *moves = (char*)realloc((void*)*moves, *moves_size * sizeof(char));
-  sprintf(*moves + strlen(*moves), "parents[%d] = new Array(", variation->id);
+  bformata(moves, "parents[%d] = new Array(", variation->id);
   if(variation->parent) {
-    sprintf(*moves + strlen(*moves), "%d,%d);\n", variation->parent->id, variation->parent_move); 
+    bformata(moves, "%d,%d);\n", variation->parent->id, variation->parent_move); 
   }
   else {
-    sprintf(*moves + strlen(*moves), "-1,%d);\n", variation->parent_move); 
+    bformata(moves, "-1,%d);\n", variation->parent_move); 
   }
  
   /* add buffer to moves */
 #ifdef DEBUG
   printf("Added moves: %d\n", variation->id);
-  printf("%s\n", variation->buffer);
+  printf("%s\n", bdata(variation->buffer));
 #endif
 
-  *moves_size += strlen(variation->buffer);
-  *moves = (char*)realloc((void*)*moves, *moves_size * sizeof(char));
-  strcat(*moves, variation->buffer);
+  bconcat(moves, variation->buffer);
 
   /* if there are children delete these first */
   if(variation->children) {
-    delete_variation(variation->children, moves, moves_size);
+    delete_variation(variation->children, moves);
   }
 
   /* if there are siblings delete these second */
   if(variation->siblings) {
-    delete_variation(variation->siblings, moves, moves_size);
+    delete_variation(variation->siblings, moves);
   }
 
 #ifdef DEBUG
@@ -431,7 +1049,7 @@ void delete_variation(VARIATION *variation, char **moves, long int *moves_size)
 #endif
 
   /* finally delete the variation itself */ 
-  free((void*)variation->buffer);
+  bdestroy(variation->buffer);
   free((void*)variation);
 
 #ifdef DEBUG
@@ -477,78 +1095,36 @@ MOVE extract_coordinates(const char* algebraic)
 }
 
 /* constructs game list from STRs, returns number of games found */
-int extract_game_list(FILE* file, const char* html_filename, char **game_list) /* !! allocates memory to game_list, it must be freed by the caller !! */
+int extract_game_list(INPUT* pgn, const PGN_INDEX *index, const CONVERTER *converter, char **game_list) /* !! allocates memory to game_list, it must be freed by the caller !! */
 {
-  char buffer[256];
-  char white[256];
-  char black[256];
-  char date[256];
+  INPUT view;
+  TAGS tags;
+  size_t entry;
 
   int game = 0;
 
-  char *url;
-  char game_index[32];
   unsigned long int buffer_size;
 
   /* allocate memory */
-  url = (char*)calloc(strlen(html_filename) + 32, sizeof(char));
   *game_list = (char*)calloc(4096, sizeof(char)); /* use initial buffer of 4k */
   buffer_size = 4096;
 
   strcpy(*game_list, "");
-  strcpy(white, "");
-  strcpy(black, "");
-  strcpy(date, "");
-
-  while(fgets(buffer, 256, file) != NULL) {
-    sscanf(buffer, "[Date \"%[^\"]\"]", date);
-    sscanf(buffer, "[White \"%[^\"]\"]", white);
-    sscanf(buffer, "[Black \"%[^\"]\"]", black);
-
-    if(strcmp(white, "") && strcmp(black, "")) {
 
-      /* generate game url */
-      strcpy(url, html_filename);
-      truncate_to_filename(url);
-      sprintf(game_index, "%d", game);
-      filecat(url, game_index);
+  /* each game's extent starts at its tags, only they are read and the movetext is never looked at */
+  for(entry = 0; entry < index->games; entry++) {
+    input_view(&view, pgn, index->entries[entry].offset, index->entries[entry].offset + index->entries[entry].length);
+    tags_read(&view, &tags); /* !! allocates memory to tags, free after use !! */
 
-#ifdef DEBUG
-      printf("(%s) %s - %s %s\n", url, white, black, date);
-#endif
-
-      /* don't display date if it is unknown */
-      if(!strcmp(date, "????.??.??")) {
-	strcpy(date, "");
-      }
+    if(*tags.known[TAG_WHITE] && *tags.known[TAG_BLACK]) {
 
       /* generate html for option list */
-      strcat(*game_list, "<option value=\"");
-      strcat(*game_list, url);
-      strcat(*game_list, "\">");
-      strcat(*game_list, white);
-      strcat(*game_list, " - ");
-      strcat(*game_list, black);
-      strcat(*game_list, " ");
-      strcat(*game_list, date);
-      strcat(*game_list, "\n");
-
-      strcpy(white, "");
-      strcpy(black, "");
-      strcpy(date, "");
-
+      append_game_list(game_list, &buffer_size, converter, entry, tags.known[TAG_WHITE], tags.known[TAG_BLACK], tags.known[TAG_DATE]);
       game++;
-
-      /* allocate more memory if buffer is running low */
-      if(strlen(*game_list) + 1024 + strlen(html_filename) > buffer_size) {
-	buffer_size += 4096;
-	*game_list = (char*)realloc((void*)*game_list, buffer_size);
-      }      
     }
-  }
 
-  /* free memory */
-  free((void*)url);
+    tags_free(&tags);
+  }
 
   return game;
 }
@@ -578,6 +1154,122 @@ void filecat(char *filename, const char *suffix)
   free((void*)extension);
 }
 
+/* waits for the workers' writers to finish their pages, keeping any earlier error */
+P2W_ERROR flush_writers(const CONVERTER *converter, P2W_ERROR error)
+{
+  int worker;
+
+  for(worker = 0; converter->writers && worker < converter->workers; worker++) {
+    if(!writer_flush(converter->writers[worker]) && error == P2W_OK) {
+      error = P2W_HTML_ERROR;
+    }
+  }
+
+  return error;
+}
+
+/* frees the workers' writers, the pages are then saved directly */
+void free_writers(CONVERTER *converter)
+{
+  int worker;
+
+  if(!converter->writers) {
+    return;
+  }
+
+  for(worker = 0; worker < converter->workers; worker++) {
+    if(converter->writers[worker]) {
+      writer_free(converter->writers[worker]);
+    }
+  }
+
+  free((void*)converter->writers);
+  converter->writers = NULL;
+}
+
+/* turns a html filename into the filename of its shared game list script */
+void game_list_script_filename(char *filename)
+{
+  char *extension;
+
+  /* replace any extension (but not a dot in the path) */
+  extension = strrchr(filename, '.');
+  if(extension && !strchr(extension, SEPERATOR)) {
+    *extension = '\0';
+  }
+
+  strcat(filename, ".games.js");
+}
+
+/* turns a html filename (or url, with / as the seperator) into that of a game's page. sharded
+   pages go in a subdirectory for each thousand games, e.g. 12/game12345.html. the buffer
+   needs room for 24 more characters, 48 if sharded */
+void game_page_filename(char *filename, int game, bool sharded, char seperator)
+{
+  char game_index[32];
+  char *name;
+  size_t length;
+
+  if(sharded) {
+    name = strrchr(filename, seperator);
+    name = name ? name + 1 : filename;
+
+    sprintf(game_index, "%d%c", game / SHARD_SIZE, seperator);
+    length = strlen(game_index);
+    memmove(name + length, name, strlen(name) + 1);
+    memcpy(name, game_index, length);
+  }
+
+  sprintf(game_index, "%d", game);
+  filecat(filename, game_index);
+}
+
+/* creates the subdirectory of a shard of the pages if it isn't there. a failure
+   shows when the pages are written */
+void make_shard_directory(const CONVERTER *converter, int shard)
+{
+  char *path;
+
+  path = (char*)calloc(strlen(converter->html_filename) + 32, sizeof(char));
+  strcpy(path, converter->html_filename);
+  truncate_to_path(path);
+  sprintf(path + strlen(path), "%d", shard);
+
+#ifdef WINDOWS
+  _mkdir(path);
+#else
+  mkdir(path, 0777);
+#endif
+
+  free((void*)path);
+}
+
+/* returns whether a page is there, along with the compressed copies the options ask for */
+bool page_exists(const CONVERTER *converter, const char *filename)
+{
+  struct stat stat_buf;
+  char *compressed_filename;
+  bool exists;
+
+  if(stat(filename, &stat_buf)) {
+    return false;
+  }
+
+  compressed_filename = (char*)calloc(strlen(filename) + 4, sizeof(char));
+
+  strcpy(compressed_filename, filename);
+  strcat(compressed_filename, ".gz");
+  exists = !(converter->options & GZIP_PAGES) || !stat(compressed_filename, &stat_buf);
+
+  strcpy(compressed_filename, filename);
+  strcat(compressed_filename, ".br");
+  exists = exists && (!(converter->options & BROTLI_PAGES) || !stat(compressed_filename, &stat_buf));
+
+  free((void*)compressed_filename);
+
+  return exists;
+}
+
 /* concatinates two paths */
 void pathcat(char *root_path, const char *path)
 {
@@ -596,7 +1288,7 @@ void pathcat(char *root_path, const char *path)
 }
 
 /* output javascript data for initial position */
-void print_initial_position(FILE* file, const char* FEN, const char* var)
+void print_initial_position(PAGE* page, const char* FEN, const char* var)
 {
   POSITION position;
   int col, row;
@@ -605,178 +1297,208 @@ void print_initial_position(FILE* file, const char* FEN, const char* var)
   setup_board(&position, FEN);
 
   /* print out position */
-  fprintf(file, "var %s = new Array(", var);
+  page_printf(page, "var %s = new Array(", var);
 
   for(row = 7; row >= 0; row--) {
     for(col = 0; col < 8; col++) {
       if(col == 7 && row == 0) {
-	fprintf(file, "%d);\n", position.board[col][row]);
+	page_printf(page, "%d);\n", position.board[col][row]);
       }
       else {
-	fprintf(file, "%d,", position.board[col][row]);
+	page_printf(page, "%d,", position.board[col][row]);
       }
     }
   }
 }
 
 /* process 1 pgn game */
-void process_game(FILE *pgn, FILE *template, const char *html_filename, const int game, const char* pieces, const char* game_list, bool credit, STRUCTURE layout)
+P2W_ERROR process_game(const CONVERTER *converter, WRITER *writer, INPUT *pgn, const int game, INDEX_ENTRY *entry, bool changed)
 {
+  const TEMPLATE *template = converter->template;
+  const char *html_filename = converter->html_filename;
+  const char *game_list = converter->game_list;
+  STRUCTURE layout = converter->layout;
+  bool sharded = (converter->options & SHARDED_PAGES) ? true : false;
   char *game_filename;
-  char game_index[32];
-  FILE *html;
-
-  char buffer[256];
-  char *tag;
-  char event[256];
-  char site[256];
-  char date[256];
-  char round[256];
-  char white[256];
-  char black[256];
-  char result[256];
-  char FEN[256];
+  PAGE html;
+  bool up_to_date;
+  P2W_ERROR error;
 
-  char *moves;
-  char *notation;
+  const SEGMENT *segment;
+  TAGS tags;
+  const char *event, *site, *date, *round, *white, *black, *result, *FEN;
+  int tag;
 
-  *event = *site = *date = *round = *white = *black = *result = *FEN = '\0';
+  bstring moves;
+  bstring notation;
 
   /* allocate memory for filename */
-  game_filename = (char*)calloc(strlen(html_filename) + 32, sizeof(char));
+  game_filename = (char*)calloc(strlen(html_filename) + 64, sizeof(char));
 
-  /* open html file */
+  /* generate html filename */
   strcpy(game_filename, html_filename);
-  sprintf(game_index, "%d", game);
-  filecat(game_filename, game_index);
-  
-  if((html = fopen(game_filename, "w")) == NULL) {
-    perror("Unable to create html file");
-    exit(1);
+  game_page_filename(game_filename, game, sharded, SEPERATOR);
+
+  /* an up to date page is only read for its tags, if they aren't known. one which has
+     lost a compressed copy is written again */
+  up_to_date = (!changed && !converter->sink && page_exists(converter, game_filename));
+  if(up_to_date && !entry) {
+    free((void*)game_filename);
+    return P2W_OK;
   }
 
   /* process STR */
-  while(fgets(buffer, 256, pgn) != NULL) {
-    sscanf(buffer, "[Event \"%[^\"]\"]", event);
-    sscanf(buffer, "[Site \"%[^\"]\"]", site);
-    sscanf(buffer, "[Date \"%[^\"]\"]", date);
-    sscanf(buffer, "[Round \"%[^\"]\"]", round);
-    sscanf(buffer, "[White \"%[^\"]\"]", white);
-    sscanf(buffer, "[Black \"%[^\"]\"]", black);
-    sscanf(buffer, "[Result \"%[^\"]\"]", result);
-    sscanf(buffer, "[FEN \"%[^\"]\"]", FEN);
+  tags_read(pgn, &tags); /* !! allocates memory to tags, free after use !! */
 
-    if(!strcmp("\n", buffer)) { break; }
-    if(!strcmp("\r\n", buffer)) { break; }
+  /* record the tags for the game list and the index */
+  if(entry) {
+    for(tag = 0; tag < NO_TAGS; tag++) {
+      record_tag(entry, tag, tags.known[tag]);
+    }
   }
 
-  /* decide on start position */
-  if(*FEN == '\0') {
-    strcpy(FEN, INITIAL_POSITION);
+  /* leave an up to date page alone, as long as it is still there */
+  if(up_to_date) {
+    tags_free(&tags);
+    free((void*)game_filename);
+    return P2W_OK;
   }
 
+  event = tags.known[TAG_EVENT];
+  site = tags.known[TAG_SITE];
+  date = tags.known[TAG_DATE];
+  round = tags.known[TAG_ROUND];
+  white = tags.known[TAG_WHITE];
+  black = tags.known[TAG_BLACK];
+  result = tags.known[TAG_RESULT];
+
+  /* decide on start position */
+  FEN = *tags.known[TAG_FEN] ? tags.known[TAG_FEN] : INITIAL_POSITION;
+
   /* process move text */
   process_moves(pgn, FEN, &moves, &notation, layout); /* !! allocates memory for move and notation, must be freed by caller !! */
 
-  /* process template file, replacing XML-like tags */
-  while(fgets(buffer, 256, template) != NULL) {
-    if(strstr(buffer, "/>") == NULL) {
-      fprintf(html, "%s", buffer);
-    }
-    else {
-      if(strstr(buffer, "<black/>")) {
-	fprintf(html, "%s\n", black);
-      }
-      if(strstr(buffer, "<current/>")) {
-	print_initial_position(html, FEN, "board");
-      }
-      if(strstr(buffer, "<date/>") && strcmp(date, "????.??.??")) {
-	fprintf(html, "%s\n", date);
-      }
-      if(strstr(buffer, "<event/>")  && strcmp(event, "?")) {
-	fprintf(html, "%s\n", event);
-      }
-      if(strstr(buffer, "<gamelist/>")) {
-	switch(layout) {
-	case FRAMESET:
-	  fprintf(html, "<select name=\"game\" onchange=\"if(this.value != 'null') parent.game.location=this.value;\">\n");
-	  fprintf(html, "<option value=\"null\">Select a game...\n");
-	  fprintf(html, "%s", game_list);
-	  fprintf(html, "</select>\n");
-	  break;
-	case LINKED:
-	  fprintf(html, "<select name=\"game\" onchange=\"if(this.value != 'null') location=this.value;\">\n");
-          fprintf(html, "<option value=\"null\">Select a game...\n");
-          fprintf(html, "%s", game_list);
-	  fprintf(html, "</select>\n");
-          break;
-	case INDIVIDUAL:
-	  break;
-	}
+  page_init(&html);
+
+  /* render the template, replacing XML-like tags */
+  for(segment = template->segments; segment < template->segments + template->count; segment++) {
+    switch(segment->type) {
+    case SEGMENT_LITERAL:
+      page_write(&html, segment->text, segment->length);
+      break;
+    case SEGMENT_BLACK:
+      page_puts(&html, black);
+      page_putc(&html, '\n');
+      break;
+    case SEGMENT_CREDIT:
+      if(converter->credit) {
+	page_puts(&html, credit_html);
       }
-      if(strstr(buffer, "<initial/>")) {
-	print_initial_position(html, FEN, "initial");
+      break;
+    case SEGMENT_CURRENT:
+      print_initial_position(&html, FEN, "board");
+      break;
+    case SEGMENT_DATE:
+      if(strcmp(date, "????.??.??")) {
+	page_puts(&html, date);
+	page_putc(&html, '\n');
       }
-      if(strstr(buffer, "<moves/>")) {
-	fprintf(html, "%s\n", moves);
+      break;
+    case SEGMENT_EVENT:
+      if(strcmp(event, "?")) {
+	page_puts(&html, event);
+	page_putc(&html, '\n');
       }
-      if(strstr(buffer, "<notation/>")) {
-	fprintf(html, "%s\n", notation);
-      }   
-      if(strstr(buffer, "<result/>") && strcmp(result, "?")) {
-	fprintf(html, "%s\n", result);
+      break;
+    case SEGMENT_GAMELIST:
+      if(!game_list) {
+	break;
       }
-      if(strstr(buffer, "<round/>") && strcmp(round, "?")) {
-	fprintf(html, "Round %s\n", round);
+      switch(layout) {
+      case FRAMESET:
+	page_puts(&html, "<select name=\"game\" onchange=\"if(this.value != 'null') parent.game.location=this.value;\">\n");
+	page_puts(&html, "<option value=\"null\">Select a game...\n");
+	page_puts(&html, game_list);
+	page_puts(&html, "</select>\n");
+	break;
+      case LINKED:
+	page_puts(&html, "<select name=\"game\" onchange=\"if(this.value != 'null') location=this.value;\">\n");
+	page_puts(&html, "<option value=\"null\">Select a game...\n");
+	page_puts(&html, game_list);
+	page_puts(&html, "</select>\n");
+	break;
+      case INDIVIDUAL:
+	break;
       }
-      if(strstr(buffer, "<site/>") && strcmp(site, "?")) {
-	fprintf(html, "%s\n", site);
+      break;
+    case SEGMENT_INITIAL:
+      print_initial_position(&html, FEN, "initial");
+      break;
+    case SEGMENT_MOVES:
+      page_write(&html, bdata(moves), blength(moves));
+      page_putc(&html, '\n');
+      break;
+    case SEGMENT_NOTATION:
+      page_write(&html, bdata(notation), blength(notation));
+      page_putc(&html, '\n');
+      break;
+    case SEGMENT_PIECES:
+      if(sharded) {
+	page_puts(&html, "../");
       }
-      if(strstr(buffer, "<white/>")) {
-	fprintf(html, "%s\n", white);
+      page_puts(&html, converter->pieces);
+      break;
+    case SEGMENT_RESULT:
+      if(strcmp(result, "?")) {
+	page_puts(&html, result);
+	page_putc(&html, '\n');
       }
-      if((tag = strstr(buffer, "<credit/>"))) {
-        *tag = '\0';
-        fprintf(html, "%s", buffer);
-        if(credit) {
-          fprintf(html, credit_html);
-        }
-        fprintf(html, "%s", tag + strlen("<credit/>"));
+      break;
+    case SEGMENT_ROUND:
+      if(strcmp(round, "?")) {
+	page_printf(&html, "Round %s\n", round);
       }
-      if((tag = strstr(buffer, "<pieces/>"))) {
-        *tag = '\0';
-        fprintf(html, "%s", buffer);
-        fprintf(html, pieces);
-        fprintf(html, "%s", tag + strlen("<pieces/>"));
+      break;
+    case SEGMENT_SITE:
+      if(strcmp(site, "?")) {
+	page_puts(&html, site);
+	page_putc(&html, '\n');
       }
+      break;
+    case SEGMENT_WHITE:
+      page_puts(&html, white);
+      page_putc(&html, '\n');
+      break;
+    default:
+      break;
     }
   }
 
-  /* close html file */
-  fclose(html);
+  /* write the page out */
+  error = write_page(converter, writer, game_filename, &html);
 
   /* free memory */
+  page_free(&html);
+  tags_free(&tags);
   free((void*)game_filename);
-  free((void*)moves);
-  free((void*)notation);
+  bdestroy(moves);
+  bdestroy(notation);
+
+  return error;
 }
 
 /* create html & javascript data for moves in pgn file */
-void process_moves(FILE *pgn, const char *FEN, char **moves, char **notation, STRUCTURE layout) /* !! allocates memory which must be freed by caller !! */
+void process_moves(INPUT *pgn, const char *FEN, bstring *moves, bstring *notation, STRUCTURE layout) /* !! allocates memory which must be freed by caller !! */
 {
   VARIATION *root, *current, *new;
   int new_id = 0;
-  unsigned long int moves_size;
-  unsigned long int notation_size;
 
-  bool in_comment = false;
   bool left_comment = false;
   bool left_variation = false;
   bool entered_variation = false;
-  char move_string[256];
-  char token[256];
-  char temp[256];
-  char *temp_pointer;
+  char move_string[16]; /* the symbol being tried as a move */
+  TOKEN token;
+  size_t digit;
   int nag;
   MOVE move;
 
@@ -784,9 +1506,7 @@ void process_moves(FILE *pgn, const char *FEN, char **moves, char **notation, ST
   root = (VARIATION*)malloc(sizeof(VARIATION));
   root->parent = root->siblings = root->children = 0;
   root->id = new_id++;
-  root->buffer_size = 1024;
-  root->buffer = (char*)calloc(root->buffer_size, sizeof(char));
-  sprintf(root->buffer, "moves[%d] = new Array(", root->id);
+  root->buffer = bformat("moves[%d] = new Array(", root->id);
 
   root->parent_move = 0;
   root->actual_move = 1;
@@ -796,291 +1516,191 @@ void process_moves(FILE *pgn, const char *FEN, char **moves, char **notation, ST
   
   current = root;
 
-  /* allocate notation buffer */
-  notation_size = 8192;
-  *notation = (char*)calloc(notation_size, sizeof(char));
-  strcpy(*notation, "<b>");
+  /* the notation, like the variations' buffers, keeps its length and grows geometrically
+     so appending to it doesn't rescan what is already there */
+  *notation = bfromcstralloc(8192, "<b>");
 
   /* parse move text */
   while(current) {
     /* fetch next token */
-    token[255] = '\0';
-    if(fscanf(pgn, "%255s", token) != 1) {
-      strcat(*notation, "</b>");
-      strcat(current->buffer, "-1,-1,-1,-1);\n"); /* exit loop if none */
-      break;
-    }
-
-    /* enlarge buffers if necessary */
-    if(strlen(*notation) + strlen(token) + 256 > notation_size) {
-      notation_size += 8192;
-      *notation = (char*)realloc((void*)*notation, notation_size * sizeof(char));
-    }
-
-    if(strlen(current->buffer) + 256 > current->buffer_size) {
-      current->buffer_size += 1024;
-      current->buffer = (char*)realloc((void*)current->buffer, current->buffer_size * sizeof(char));
-    }
-
-    /* parse token */
-    while(strcmp(token, "")) {
+    lexer_next(pgn, &token);
 
 #ifdef DEBUG
-    printf("Token: \"%s\"\n", token);
+    printf("Token: \"%.*s\"\n", (int)token.length, token.text);
 #endif
 
-      /* if in comment copy to notation */
-      if(in_comment) {
-	if(strchr(token, '}')) {
-	  temp_pointer = strchr(token, '}');
-	  *temp_pointer = '\0';
-	  strcat(*notation, " ");
-	  strcat(*notation, token);
-
-	  temp_pointer++;
-	  strcpy(temp, temp_pointer);
-	  strcpy(token, temp);
-	  in_comment = false;
-	  left_comment = true;
-	  continue;
-	}
-	else {
-	  strcat(*notation, " ");
-	  strcat(*notation, token);
-	  strcpy(token, "");
-	  continue;
-	}
-      }
+    switch(token.type) {
+    case TOKEN_END:
+      bcatcstr(*notation, "</b>");
+      bcatcstr(current->buffer, "-1,-1,-1,-1);\n"); /* exit loop if none */
+      current = 0;
+      continue;
 
-      /* Start of a comment? */
-      if(token[0] == '{') {
-	if(current->id == 0) {
-	  strcat(*notation, "</b>");
-	}
-	strcat(*notation, "\n");
-	strcpy(temp, token + 1);
-	strcpy(token, temp);
-	in_comment = true;
-	continue;
+    case TOKEN_COMMENT:
+      /* copy to notation */
+      if(current->id == 0) {
+	bcatcstr(*notation, "</b>");
       }
+      bcatcstr(*notation, "\n");
+      append_comment(*notation, token.text, token.length);
+      left_comment = true;
+      continue;
 
-      /* check for result */
-      if(!strcmp(token, "1-0") || !strcmp(token, "0-1") || !strcmp(token, "1/2-1/2") || !strcmp(token, "*")) {
-	strcat(current->buffer, "-1,-1,-1,-1);\n");
-	current = 0;
-	break;
-      }
-      
+    case TOKEN_RESULT:
+      bcatcstr(current->buffer, "-1,-1,-1,-1);\n");
+      current = 0;
+      continue;
+
+    case TOKEN_NAG:
       /* Replace NAGS with comment/symbol */
-      if(token[0] == '$') {
-	sscanf(token + 1, "%d", &nag);
-
-	if(nag < 140) {
-	  if(isalpha(NAGS[nag][0])) {
-	    strcat(*notation, " ");
-	  }
-	  strcat(*notation, NAGS[nag]);
-	}
+      for(nag = 0, digit = 0; digit < token.length && nag < 140; digit++) {
+	nag = nag * 10 + (token.text[digit] - '0');
+      }
 
-	temp_pointer = token + 1;
-	while(isdigit(*temp_pointer)) {
-	  temp_pointer++;
+      if(token.length && nag < 140) {
+	if(isalpha(NAGS[nag][0])) {
+	  bcatcstr(*notation, " ");
 	}
-	strcpy(temp, temp_pointer);
-	strcpy(token, temp);
-	continue;
+	bcatcstr(*notation, NAGS[nag]);
       }
+      continue;
 
-      /* Start of a variation? */
-      if(token[0] == '(') {
-	strcpy(temp, token + 1);
-	strcpy(token, temp);
-	if(current->id == 0) {
-	  strcat(*notation, "</b>");
-	}
-	if(!entered_variation) {
-	  strcat(*notation, "\n");
-	}
-	strcat(*notation, "(");
+    case TOKEN_OPEN_VARIATION:
+      if(current->id == 0) {
+	bcatcstr(*notation, "</b>");
+      }
+      if(!entered_variation) {
+	bcatcstr(*notation, "\n");
+      }
+      bcatcstr(*notation, "(");
 
-	/* create child variation */
-	new = (VARIATION*)malloc(sizeof(VARIATION));
-	new->parent = current;
-	new->siblings = new->children = 0;
-	new->parent_move = current->relative_move - 2;
-	new->actual_move = current->actual_move - 1;
-	new->relative_move = 1;
+      /* create child variation */
+      new = (VARIATION*)malloc(sizeof(VARIATION));
+      new->parent = current;
+      new->siblings = new->children = 0;
+      new->parent_move = current->relative_move - 2;
+      new->actual_move = current->actual_move - 1;
+      new->relative_move = 1;
 
-	new->position = current->previous_position;
+      new->position = current->previous_position;
 	
-	new->id = new_id++;
-	new->buffer_size = 1024;
-	new->buffer = (char*)calloc(new->buffer_size, sizeof(char));
-	sprintf(new->buffer, "moves[%d] = new Array(", new->id);
+      new->id = new_id++;
+      new->buffer = bformat("moves[%d] = new Array(", new->id);
       
-	/* add variation to tree */
-	if(current->children) {
-	  current = current->children;
-	  while(current->siblings) {
-	    current = current->siblings;
-	  }      
-	  current->siblings = new;
-	}
-	else {
-	  current->children = new;
-	}
-
-	/* make current variation */
-	current = new;
-	entered_variation = true;
-	left_comment = false;
-	left_variation = false;
-	continue;
+      /* add variation to tree */
+      if(current->children) {
+	current = current->children;
+	while(current->siblings) {
+	  current = current->siblings;
+	}      
+	current->siblings = new;
       }
-
-      /* end of variation? */
-      if(token[0] == ')') {
-	strcpy(temp, token + 1);
-	strcpy(token, temp);
-	strcat(*notation, ")");
-
-	/* terminate variation */
-	if(current->parent) {
-	  strcat(current->buffer, "-1,-1,-1,-1);\n");
-	  current = current->parent;
-	}
-	entered_variation = false;
-	left_variation = true;
-	continue;
-      }
-
-      /* move number? */
-      if(isdigit(token[0]) || token[0] == '.') {
-	strcpy(temp, token + 1);
-	strcpy(token, temp);
-	continue;
+      else {
+	current->children = new;
       }
-     
-#ifdef DEBUG
-      printf("Move token: \"%s\"\n", token);
-#endif
 
-      /* parse move */
-      strcpy(temp, token);
-      temp_pointer = temp;
-      while(isalnum(*temp_pointer) || *temp_pointer == '+' || *temp_pointer == '-' || *temp_pointer == '#' || *temp_pointer == '=') {
-	temp_pointer++;
-      }
-      /* if no valid characters, we are confused so abort */
-      if(temp_pointer == temp) {
-	strcpy(token, "");
-	continue;
-      }
-      strcpy(token, temp_pointer);
-      *temp_pointer = '\0';
-      strcpy(move_string, temp);
-
-      /* convert the move, checking for failure */
-      move = algebraic_to_move(move_string, &current->position);  
-      if(move.from_col == -1) {
-	continue;
-      }
+      /* make current variation */
+      current = new;
+      entered_variation = true;
+      left_comment = false;
+      left_variation = false;
+      continue;
 
-#ifdef DEBUG
-      printf("Move: \"%s\"\n", move_string);
-#endif
+    case TOKEN_CLOSE_VARIATION:
+      bcatcstr(*notation, ")");
 
-      /* convert move */
-      if(!entered_variation || left_comment) {
-	strcat(*notation, "\n");
+      /* terminate variation */
+      if(current->parent) {
+	bcatcstr(current->buffer, "-1,-1,-1,-1);\n");
+	current = current->parent;
       }
+      entered_variation = false;
+      left_variation = true;
+      continue;
 
-      if(current->id == 0 && (left_comment || left_variation)) {
-	strcat(*notation, "<p><b>");
-      }
+    case TOKEN_MOVE_NUMBER:
+      continue;
 
-      if(current->position.turn == WHITE) {
-	sprintf(*notation + strlen(*notation), "%d.", (current->actual_move + 1) / 2);
-      }
-      else {
-	if(current->relative_move == 1 || left_comment || left_variation) {
-	  sprintf(*notation + strlen(*notation), "%d... ", (current->actual_move + 1) / 2);
-	}
-      } 
+    case TOKEN_SYMBOL:
+      break;
+    }
 
-      if(layout == FRAMESET) {
-	sprintf(*notation + strlen(*notation), "<a class=\"move\" href=\"javascript:parent.board.jumpto(%d, %d);\" id=\"v%dm%d\">%s</a>", current->id, current->relative_move, current->id, current->relative_move, move_string);
-      }
-      else {
-	sprintf(*notation + strlen(*notation), "<a class=\"move\" href=\"javascript:jumpto(%d, %d);\" id=\"v%dm%d\">%s</a>", current->id, current->relative_move, current->id, current->relative_move, move_string);
-      }
-      append_move(current->buffer, &move, &current->position);
-      
-      /* execute move */
-      current->previous_position = current->position;
-      make_move(&current->position, &move);
-      left_comment = false;
-      left_variation = false;
-      entered_variation = false;
-      current->actual_move++;
-      current->relative_move++;
+    /* a symbol longer than any move can't be one, the others are copied only because
+       algebraic_to_move wants a string, the notation is written from the token itself */
+    if(token.length >= sizeof(move_string)) {
+      continue;
     }
-  }
 
-  /* delete tree structure merging buffers into moves buffer */
-  *moves = (char*)calloc(1, sizeof(char));
-  **moves = '\0';
-  moves_size = 1;
-  delete_variation(root, moves, &moves_size);
-}
+    memcpy(move_string, token.text, token.length);
+    move_string[token.length] = '\0';
 
-/* strips comments and variations (including NAGs) */
-void strip(FILE *pgn)
-{
-  char test;
-  int depth;
-  
-  for(;;) {
-    while((test = getc(pgn)) == ' ' || test == '\n' || test == '\r') {
+    /* convert the move, checking for failure */
+    move = algebraic_to_move(move_string, &current->position);  
+    if(move.from_col == -1) {
+      continue;
     }
 
-    if(test != '{' && test != '(' && test != '$') {
-      ungetc(test, pgn);
-      return;
+#ifdef DEBUG
+    printf("Move: \"%.*s\"\n", (int)token.length, token.text);
+#endif
+
+    /* convert move */
+    if(!entered_variation || left_comment) {
+      bcatcstr(*notation, "\n");
     }
-    
-    if(test == '$') {
-        while((test = getc(pgn)) != ' ' && test != '\n' && test != '\r') {
-        }
-        ungetc(test, pgn);
-        continue;
+
+    if(current->id == 0 && (left_comment || left_variation)) {
+      bcatcstr(*notation, "<p><b>");
     }
 
-    if(test == '{') {
-      while(getc(pgn) != '}') {
+    if(current->position.turn == WHITE) {
+      bformata(*notation, "%d.", (current->actual_move + 1) / 2);
+    }
+    else {
+      if(current->relative_move == 1 || left_comment || left_variation) {
+	bformata(*notation, "%d... ", (current->actual_move + 1) / 2);
       }
-      continue;
+    } 
+
+    if(layout == FRAMESET) {
+      bformata(*notation, "<a class=\"move\" href=\"javascript:parent.board.jumpto(%d, %d);\" id=\"v%dm%d\">%.*s</a>", current->id, current->relative_move, current->id, current->relative_move, (int)token.length, token.text);
+    }
+    else {
+      bformata(*notation, "<a class=\"move\" href=\"javascript:jumpto(%d, %d);\" id=\"v%dm%d\">%.*s</a>", current->id, current->relative_move, current->id, current->relative_move, (int)token.length, token.text);
     }
+    append_move(current->buffer, &move, &current->position);
+      
+    /* execute move */
+    current->previous_position = current->position;
+    make_move(&current->position, &move);
+    left_comment = false;
+    left_variation = false;
+    entered_variation = false;
+    current->actual_move++;
+    current->relative_move++;
+  }
 
-    depth = 1;
-    
-    while(depth) {
-      test = getc(pgn);
+  /* delete tree structure merging buffers into moves buffer */
+  *moves = bfromcstralloc(8192, "");
+  delete_variation(root, *moves);
+}
 
-      if(test == '{') {
-	while(getc(pgn) != '}') {
-	}
-      }
+/* records a tag of a game */
+void record_tag(INDEX_ENTRY *entry, int tag, const char *value)
+{
+  entry->tags[tag] = (char*)calloc(strlen(value) + 1, sizeof(char));
+  strcpy(entry->tags[tag], value);
+}
 
-      if(test == '(') {
-	depth++;
-      }
+/* reports the percentage of the pgn text before a game, measuring by bytes keeps the
+   meter even when games vary in length and doesn't depend on counting them */
+void report_progress(const PGN_INDEX *index, const INPUT *pgn, size_t game,
+		     void (*progress)(float percentage, void *context), void *progress_context)
+{
+  size_t done;
 
-      if(test == ')') {
-	depth--;
-      }
-    }
-  }
+  done = (game < index->games) ? index->entries[game].offset : pgn->length;
+  (*progress)(pgn->length ? (float)((double)done * 100 / pgn->length) : 100, progress_context);
 }
 
 /* removes the filename just leaving the path component */
@@ -1114,3 +1734,50 @@ void truncate_to_filename(char *filename)
   strcpy(filename, copy);
   free((void*)copy);
 }
+
+/* hands a finished page to the sink, or writes it to its file */
+P2W_ERROR write_page(const CONVERTER *converter, WRITER *writer, const char *filename, PAGE *page)
+{
+  PAGE compressed;
+
+  if(converter->sink) {
+    return (*converter->sink)(filename, page->data, page->length, converter->sink_context) ? P2W_OK : P2W_HTML_ERROR;
+  }
+
+  /* a writer takes the pages and any failure shows when it is flushed. the compressed
+     copies are made first as they need the page */
+  if(writer) {
+    if(converter->options & GZIP_PAGES) {
+      if(!page_gzip(page, &compressed)) {
+	return P2W_COMPRESSION_ERROR;
+      }
+      writer_queue(writer, filename, ".gz", &compressed);
+    }
+
+    if(converter->options & BROTLI_PAGES) {
+      if(!page_brotli(page, &compressed)) {
+	return P2W_COMPRESSION_ERROR;
+      }
+      writer_queue(writer, filename, ".br", &compressed);
+    }
+
+    writer_queue(writer, filename, "", page);
+    return P2W_OK;
+  }
+
+  if(!page_save(page, filename)) {
+    return P2W_HTML_ERROR;
+  }
+
+  /* compressed copies for servers which can send them instead, this is done
+     by whichever worker rendered the page */
+  if((converter->options & GZIP_PAGES) && !page_save_gzip(page, filename)) {
+    return P2W_COMPRESSION_ERROR;
+  }
+
+  if((converter->options & BROTLI_PAGES) && !page_save_brotli(page, filename)) {
+    return P2W_COMPRESSION_ERROR;
+  }
+
+  return P2W_OK;
+}
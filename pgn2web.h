@@ -18,19 +18,78 @@
   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#include <stddef.h>
+
 #include "bool.h"
 
 /* typdefs for discrete parameters */
 typedef enum { FRAMESET, LINKED, INDIVIDUAL } STRUCTURE;
 
+/* option flags */
+#define SHARED_GAME_LIST 1 /* write the game list once as a script shared by the linked pages */
+#define SIDECAR_INDEX    2 /* keep an index of the games beside the pgn file and reuse it */
+#define INCREMENTAL      4 /* only rewrite the pages whose game, template or options changed */
+#define APPEND           8 /* only convert the games added to the pgn since the index was made */
+#define GZIP_PAGES      16 /* write a gzip compressed copy of each page beside it (.gz) */
+#define BROTLI_PAGES    32 /* write a brotli compressed copy of each page beside it (.br) */
+#define SHARDED_PAGES   64 /* write the game pages into a subdirectory for each thousand games */
+#define NO_IMAGE_COPY  128 /* don't copy the piece images beside the pages, the caller does (pgn2web_copy_images) */
+#define SNAPSHOT_PGN   256 /* read the pgn into memory rather than mapping it, for a pgn which may be rewritten meanwhile */
+
+/* error codes. the last two are only warnings, every page was written but the next
+   conversion can't reuse the work of this one */
+typedef enum { P2W_OK, P2W_TEMPLATE_ERROR, P2W_IMAGES_ERROR, P2W_PGN_ERROR, P2W_HTML_ERROR, P2W_COMPRESSION_ERROR,
+	       P2W_INDEX_ERROR, P2W_MANIFEST_ERROR } P2W_ERROR;
+
+#define P2W_WARNING(error) ((error) == P2W_INDEX_ERROR || (error) == P2W_MANIFEST_ERROR)
+
+/* a converter holds the settings and compiled templates used to convert pgn files, and
+   what is kept from one conversion to the next. converters are independent, so threads
+   may each convert with their own, but a converter must only be used by one thread at a time */
+typedef struct converter CONVERTER;
+
+/* receives each page of an in-memory conversion with the filename it would have been
+   written to, returns false if it can't be taken. with more than one job the sink is
+   called from the worker threads, possibly at the same time */
+typedef bool (*P2W_SINK)(const char *filename, const char *data, size_t length, void *context);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* compiles the templates and starts the workers, *converter is NULL on error */
+P2W_ERROR pgn2web_create(CONVERTER **converter, const char *resource_path, bool credit, const char *pieces,
+			 STRUCTURE layout, int options, int jobs);
+
+/* converts a pgn file, any number may be converted with the same converter. progress is
+   given the percentage of the pgn text converted so far */
+P2W_ERROR pgn2web_convert(CONVERTER *converter, const char *pgn_filename, const char *html_filename,
+			  void (*progress)(float percentage, void *context), void *progress_context);
+
+
+/* converts a pgn held in memory, the pages go to the sink and no files are read or written.
+   html_filename only names the pages, the images can be copied beside them separately */
+P2W_ERROR pgn2web_convert_buffer(CONVERTER *converter, const char *pgn_data, size_t length, const char *html_filename,
+				 P2W_SINK sink, void *sink_context,
+				 void (*progress)(float percentage, void *context), void *progress_context);
+P2W_ERROR pgn2web_copy_images(CONVERTER *converter, const char *html_filename);
+
+void pgn2web_destroy(CONVERTER *converter);
+const char *pgn2web_error(P2W_ERROR error); /* describes an error code */
+P2W_ERROR pgn2web_warning(const CONVERTER *converter); /* a warning from the last conversion, P2W_OK if none */
+
+/* converts a single pgn file, returns an error code (or a warning if it succeeded) */
 int pgn2web(const char *resource_path, const char *pgn_filename, const char *html_filename,
-	    bool credit, const char *pieces, STRUCTURE layout,
+	    bool credit, const char *pieces, STRUCTURE layout, int options, int jobs,
 	    void (*progress)(float percentage, void *context), void *progress_context);
 
+/* converts the pgn, then again each time wait returns true, keeping the templates etc
+   from one conversion to the next */
+int pgn2web_watch(const char *resource_path, const char *pgn_filename, const char *html_filename,
+		  bool credit, const char *pieces, STRUCTURE layout, int options, int jobs,
+		  void (*progress)(float percentage, void *context), void *progress_context,
+		  bool (*wait)(void *context), void *wait_context);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,236 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "pool.h"
+
+#include <stdlib.h>
+
+#ifndef WINDOWS
+
+#include <pthread.h>
+
+#include "bool.h"
+
+/* tasks waiting to be run are kept in a circular queue */
+#define QUEUE_PER_THREAD 4
+
+typedef struct {
+  TASK task;
+  void *argument;
+} QUEUED_TASK;
+
+typedef struct {
+  POOL *pool;
+  int index;
+} WORKER;
+
+struct pool {
+  pthread_t *threads;
+  WORKER *workers;
+  int no_threads;
+
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  pthread_cond_t idle;
+
+  QUEUED_TASK *queue;
+  int queue_size;
+  int head;
+  int length;
+  int running;
+  bool stopping;
+};
+
+/* function prototypes */
+void *worker_main(void *argument);
+
+/* starts a pool of worker threads */
+POOL *pool_create(int threads)
+{
+  POOL *pool;
+  int thread;
+
+  if(threads < 1) {
+    return NULL;
+  }
+
+  pool = (POOL*)calloc(1, sizeof(POOL));
+  pool->threads = (pthread_t*)calloc(threads, sizeof(pthread_t));
+  pool->workers = (WORKER*)calloc(threads, sizeof(WORKER));
+  pool->queue_size = threads * QUEUE_PER_THREAD;
+  pool->queue = (QUEUED_TASK*)calloc(pool->queue_size, sizeof(QUEUED_TASK));
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->not_empty, NULL);
+  pthread_cond_init(&pool->not_full, NULL);
+  pthread_cond_init(&pool->idle, NULL);
+
+  for(thread = 0; thread < threads; thread++) {
+    pool->workers[thread].pool = pool;
+    pool->workers[thread].index = thread;
+
+    if(pthread_create(&pool->threads[thread], NULL, worker_main, &pool->workers[thread])) {
+      break;
+    }
+  }
+  pool->no_threads = thread;
+
+  /* if no threads could be started there is no pool */
+  if(pool->no_threads == 0) {
+    pool_destroy(pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
+/* waits for outstanding tasks, then stops and frees the pool */
+void pool_destroy(POOL *pool)
+{
+  int thread;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->not_empty);
+  pthread_mutex_unlock(&pool->lock);
+
+  for(thread = 0; thread < pool->no_threads; thread++) {
+    pthread_join(pool->threads[thread], NULL);
+  }
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->not_empty);
+  pthread_cond_destroy(&pool->not_full);
+  pthread_cond_destroy(&pool->idle);
+
+  free((void*)pool->queue);
+  free((void*)pool->workers);
+  free((void*)pool->threads);
+  free((void*)pool);
+}
+
+/* queues a task, blocking while the queue is full */
+void pool_submit(POOL *pool, TASK task, void *argument)
+{
+  QUEUED_TASK *queued;
+
+  pthread_mutex_lock(&pool->lock);
+
+  while(pool->length == pool->queue_size) {
+    pthread_cond_wait(&pool->not_full, &pool->lock);
+  }
+
+  queued = &pool->queue[(pool->head + pool->length) % pool->queue_size];
+  queued->task = task;
+  queued->argument = argument;
+  pool->length++;
+
+  pthread_cond_signal(&pool->not_empty);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/* returns the number of workers */
+int pool_threads(const POOL *pool)
+{
+  return pool->no_threads;
+}
+
+/* waits until every submitted task has finished */
+void pool_wait(POOL *pool)
+{
+  pthread_mutex_lock(&pool->lock);
+
+  while(pool->length || pool->running) {
+    pthread_cond_wait(&pool->idle, &pool->lock);
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/* worker thread, runs tasks until the pool is stopped and the queue is empty */
+void *worker_main(void *argument)
+{
+  WORKER *worker = (WORKER*)argument;
+  POOL *pool = worker->pool;
+  QUEUED_TASK queued;
+
+  pthread_mutex_lock(&pool->lock);
+
+  for(;;) {
+    while(!pool->length && !pool->stopping) {
+      pthread_cond_wait(&pool->not_empty, &pool->lock);
+    }
+
+    if(!pool->length) {
+      break;
+    }
+
+    /* take the task from the head of the queue */
+    queued = pool->queue[pool->head];
+    pool->head = (pool->head + 1) % pool->queue_size;
+    pool->length--;
+    pool->running++;
+    pthread_cond_signal(&pool->not_full);
+
+    /* run it without holding the lock */
+    pthread_mutex_unlock(&pool->lock);
+    (*queued.task)(queued.argument, worker->index);
+    pthread_mutex_lock(&pool->lock);
+
+    pool->running--;
+    if(!pool->length && !pool->running) {
+      pthread_cond_broadcast(&pool->idle);
+    }
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+#else
+
+/* no thread support, callers fall back to doing the work themselves */
+
+POOL *pool_create(int threads)
+{
+  return NULL;
+}
+
+void pool_destroy(POOL *pool)
+{
+}
+
+void pool_submit(POOL *pool, TASK task, void *argument)
+{
+  (*task)(argument, 0);
+}
+
+int pool_threads(const POOL *pool)
+{
+  return 1;
+}
+
+void pool_wait(POOL *pool)
+{
+}
+
+#endif
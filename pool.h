@@ -0,0 +1,38 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+/* a fixed set of worker threads taking tasks from a queue, each task is told which
+   worker (0 to threads - 1) is running it so that per-worker state can be kept */
+typedef struct pool POOL;
+
+typedef void (*TASK)(void *argument, int worker);
+
+/*** Function prototypes ***/
+
+POOL *pool_create(int threads); /** Starts a pool of worker threads, NULL if threads can't be created */
+void pool_destroy(POOL *pool); /** Waits for outstanding tasks, then stops and frees the pool */
+void pool_submit(POOL *pool, TASK task, void *argument); /** Queues a task, blocking while the queue is full */
+int pool_threads(const POOL *pool); /** Returns the number of workers */
+void pool_wait(POOL *pool); /** Waits until every submitted task has finished */
+
+#endif
@@ -0,0 +1,206 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "scan.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+
+/* use vector instructions on x86 compilers that let us pick them at runtime */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+/* searches for a '[' at the start of a line, returns a pointer to it or NULL */
+typedef const char *(*TAG_LINE_FINDER)(const char *from, const char *end);
+
+/* function prototypes */
+void add_extent(GAME_EXTENT **extents, size_t *games, size_t *size, size_t offset, size_t length);
+const char *find_tag_line(const char *from, const char *end);
+#ifdef SCAN_X86
+const char *find_tag_line_avx2(const char *from, const char *end);
+const char *find_tag_line_sse2(const char *from, const char *end);
+#endif
+bool follows_tag_line(const char *data, const char *bracket, const char *end);
+bool is_tag_pair(const char *bracket, const char *end);
+
+/* finds every game in the text, a game starts with a tag pair line that doesn't follow another */
+size_t scan_games(const char *data, size_t length, GAME_EXTENT **extents)
+{
+  TAG_LINE_FINDER find = find_tag_line;
+  const char *end = data + length;
+  const char *start, *bracket;
+  size_t games = 0;
+  size_t size = 1024;
+
+  *extents = (GAME_EXTENT*)malloc(size * sizeof(GAME_EXTENT));
+
+#ifdef SCAN_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")) {
+    find = find_tag_line_avx2;
+  }
+  else if(__builtin_cpu_supports("sse2")) {
+    find = find_tag_line_sse2;
+  }
+#endif
+
+  /* anything before the first tag is garbage */
+  if(length == 0 || (start = memchr(data, '[', length)) == NULL) {
+    return 0;
+  }
+
+  bracket = start;
+  while((bracket = (*find)(bracket, end))) {
+
+    /* only a whole tag pair opening counts, which rules out "[%clk ...]" and the like in comments */
+    if(is_tag_pair(bracket, end) && !follows_tag_line(data, bracket, end)) {
+      add_extent(extents, &games, &size, start - data, bracket - start);
+      start = bracket;
+    }
+  }
+
+  add_extent(extents, &games, &size, start - data, end - start);
+
+  return games;
+}
+
+/* appends an extent to the array, enlarging it as required */
+void add_extent(GAME_EXTENT **extents, size_t *games, size_t *size, size_t offset, size_t length)
+{
+  if(*games == *size) {
+    *size *= 2;
+    *extents = (GAME_EXTENT*)realloc((void*)*extents, *size * sizeof(GAME_EXTENT));
+  }
+
+  (*extents)[*games].offset = offset;
+  (*extents)[*games].length = length;
+  (*games)++;
+}
+
+/* searches for a '[' straight after a newline, one line at a time */
+const char *find_tag_line(const char *from, const char *end)
+{
+  const char *newline;
+
+  while(from < end - 1 && (newline = memchr(from, '\n', end - 1 - from))) {
+    if(newline[1] == '[') {
+      return newline + 1;
+    }
+    from = newline + 1;
+  }
+
+  return NULL;
+}
+
+#ifdef SCAN_X86
+
+/* as find_tag_line, comparing 32 bytes at a time */
+__attribute__((target("avx2")))
+const char *find_tag_line_avx2(const char *from, const char *end)
+{
+  const __m256i newline = _mm256_set1_epi8('\n');
+  const __m256i bracket = _mm256_set1_epi8('[');
+  __m256i current, next;
+  unsigned int mask;
+
+  /* each byte is compared with '\n' and the byte after it with '[' */
+  while(end - from >= 33) {
+    current = _mm256_loadu_si256((const __m256i*)from);
+    next = _mm256_loadu_si256((const __m256i*)(from + 1));
+    mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(current, newline),
+								_mm256_cmpeq_epi8(next, bracket)));
+    if(mask) {
+      return from + __builtin_ctz(mask) + 1;
+    }
+    from += 32;
+  }
+
+  return find_tag_line(from, end);
+}
+
+/* as find_tag_line, comparing 16 bytes at a time */
+__attribute__((target("sse2")))
+const char *find_tag_line_sse2(const char *from, const char *end)
+{
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i bracket = _mm_set1_epi8('[');
+  __m128i current, next;
+  unsigned int mask;
+
+  while(end - from >= 17) {
+    current = _mm_loadu_si128((const __m128i*)from);
+    next = _mm_loadu_si128((const __m128i*)(from + 1));
+    mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(current, newline),
+							 _mm_cmpeq_epi8(next, bracket)));
+    if(mask) {
+      return from + __builtin_ctz(mask) + 1;
+    }
+    from += 16;
+  }
+
+  return find_tag_line(from, end);
+}
+
+#endif
+
+/* tests whether the line before the one starting at bracket is also a tag pair */
+bool follows_tag_line(const char *data, const char *bracket, const char *end)
+{
+  const char *line = bracket - 1; /* the newline ending the previous line */
+
+  while(line > data && *(line - 1) != '\n') {
+    line--;
+  }
+
+  return is_tag_pair(line, end);
+}
+
+/* tests whether the line starting at bracket opens a tag pair, a '[' then a tag name
+   and the quote starting its value. a movetext line which happens to start with '['
+   (such as a comment carrying on with "[%clk ...]") doesn't */
+bool is_tag_pair(const char *bracket, const char *end)
+{
+  const char *position = bracket + 1;
+
+  if(bracket >= end || *bracket != '[') {
+    return false;
+  }
+
+  for(; position < end && (*position == ' ' || *position == '\t'); position++) {
+  }
+
+  /* the name begins with a letter */
+  if(position >= end || !isalpha((unsigned char)*position)) {
+    return false;
+  }
+
+  for(; position < end && (isalnum((unsigned char)*position) || *position == '_'); position++) {
+  }
+
+  for(; position < end && (*position == ' ' || *position == '\t'); position++) {
+  }
+
+  return position < end && *position == '"';
+}
@@ -0,0 +1,196 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "tags.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* perfect hash of the recorded tag names, TAG_SLOTS maps it to the TAG_ index */
+#define TAG_HASH(name, length) (((unsigned char)(name)[0] + (unsigned char)(name)[(length) - 1] + 5 * (length)) & 15)
+
+const int TAG_SLOTS[16] = {
+  TAG_OTHER, TAG_OTHER, TAG_EVENT, TAG_FEN, TAG_RESULT, TAG_WHITE, TAG_BLACK, TAG_OTHER,
+  TAG_OTHER, TAG_OTHER, TAG_OTHER, TAG_OTHER, TAG_SITE, TAG_DATE, TAG_OTHER, TAG_ROUND
+};
+
+#define IS_BLANK(c) ((c) == ' ' || (c) == '\t')
+#define IS_SPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
+
+/* function prototypes */
+void store_tag(TAGS *tags, TAG_PAIR *pair);
+
+/* finds the TAG_ index of a tag name with a single probe of the perfect hash */
+int tag_lookup(const char *name, size_t length)
+{
+  int tag;
+
+  if(length == 0) {
+    return TAG_OTHER;
+  }
+
+  tag = TAG_SLOTS[TAG_HASH(name, length)];
+
+  if(tag == TAG_OTHER || strlen(TAG_NAMES[tag]) != length || memcmp(TAG_NAMES[tag], name, length)) {
+    return TAG_OTHER;
+  }
+
+  return tag;
+}
+
+/* reads a tag pair, [Name "value"], at the cursor in a single pass. \" and \\ in the value
+   are unescaped and a value missing its closing quote runs to the end of the line. returns
+   false, leaving the cursor where it was, if there isn't a tag pair at the cursor */
+bool tag_pair_read(INPUT *input, TAG_PAIR *pair)
+{
+  const char *data = input->data;
+  size_t length = input->length;
+  size_t position = input->position;
+  size_t start, end;
+  char *value;
+
+  if(position >= length || data[position] != '[') {
+    return false;
+  }
+
+  /* the name runs up to whitespace or the opening quote */
+  for(position++; position < length && IS_BLANK(data[position]); position++) {
+  }
+
+  for(start = position; position < length && !IS_SPACE(data[position]) && data[position] != '"' && data[position] != ']'; position++) {
+  }
+
+  pair->name = data + start;
+  pair->name_length = position - start;
+
+  for(; position < length && IS_BLANK(data[position]); position++) {
+  }
+
+  if(pair->name_length == 0 || position >= length || data[position] != '"') {
+    return false;
+  }
+
+  /* find the end of the value, stepping over escaped characters */
+  for(start = ++position; position < length && data[position] != '"' && data[position] != '\n'; position++) {
+    if(data[position] == '\\' && position + 1 < length && (data[position + 1] == '"' || data[position + 1] == '\\')) {
+      position++;
+    }
+  }
+
+  end = position;
+  if(end < length && data[end] == '"') {
+    position++;
+  }
+  else if(end > start && data[end - 1] == '\r') {
+    end--;
+  }
+
+  /* copy the value without the escapes */
+  pair->value = value = (char*)calloc(end - start + 1, sizeof(char));
+  while(start < end) {
+    if(data[start] == '\\' && start + 1 < end && (data[start + 1] == '"' || data[start + 1] == '\\')) {
+      start++;
+    }
+    *value++ = data[start++];
+  }
+
+  for(; position < length && IS_BLANK(data[position]); position++) {
+  }
+
+  if(position < length && data[position] == ']') {
+    position++;
+  }
+
+  pair->tag = tag_lookup(pair->name, pair->name_length);
+  input->position = position;
+
+  return true;
+}
+
+/* frees the values of a tag pair section */
+void tags_free(TAGS *tags)
+{
+  size_t other;
+  int tag;
+
+  for(tag = 0; tag < NO_TAGS; tag++) {
+    free((void*)tags->known[tag]);
+  }
+
+  for(other = 0; other < tags->count; other++) {
+    free((void*)tags->others[other].value);
+  }
+
+  free((void*)tags->others);
+}
+
+/* reads the tag pair section at the cursor, it ends at the first line which isn't a tag
+   pair (or a % escape). a tag which appears twice takes its last value */
+void tags_read(INPUT *input, TAGS *tags)
+{
+  TAG_PAIR pair;
+  int tag;
+
+  memset(tags, 0, sizeof(TAGS));
+
+  for(;;) {
+    while(input->position < input->length && IS_SPACE(input->data[input->position])) {
+      input->position++;
+    }
+
+    if(input->position >= input->length ||
+       (input->data[input->position] != '[' && input->data[input->position] != '%')) {
+      break;
+    }
+
+    /* skip escaped lines and anything else that isn't a tag pair */
+    if(tag_pair_read(input, &pair)) {
+      store_tag(tags, &pair);
+    }
+    else {
+      input_skip_to(input, '\n');
+    }
+  }
+
+  /* missing tags are empty */
+  for(tag = 0; tag < NO_TAGS; tag++) {
+    if(!tags->known[tag]) {
+      tags->known[tag] = (char*)calloc(1, sizeof(char));
+    }
+  }
+}
+
+/* adds a tag pair to the section, replacing an earlier value of a recorded tag */
+void store_tag(TAGS *tags, TAG_PAIR *pair)
+{
+  if(pair->tag != TAG_OTHER) {
+    free((void*)tags->known[pair->tag]);
+    tags->known[pair->tag] = pair->value;
+    return;
+  }
+
+  if(tags->count == tags->size) {
+    tags->size = tags->size ? tags->size * 2 : 8;
+    tags->others = (TAG_PAIR*)realloc((void*)tags->others, tags->size * sizeof(TAG_PAIR));
+  }
+
+  tags->others[tags->count++] = *pair;
+}
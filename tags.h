@@ -0,0 +1,58 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef _TAGS_H_
+#define _TAGS_H_
+
+#include <stddef.h>
+
+#include "bool.h"
+#include "index.h"
+#include "input.h"
+
+/* tag is the TAG_ index of the tag, or TAG_OTHER for one the index doesn't record. like
+   a token, the name points into the input and isn't nul terminated, the value is allocated */
+#define TAG_OTHER (-1)
+
+typedef struct {
+  int tag;
+  const char *name;
+  size_t name_length;
+  char *value;
+} TAG_PAIR;
+
+/* the tag pair section of a game. the recorded tags are held by their TAG_ index (empty
+   if the game doesn't have one), any others are kept in the order they appear */
+typedef struct {
+  char *known[NO_TAGS];
+  TAG_PAIR *others;
+  size_t count;
+  size_t size;
+} TAGS;
+
+/*** Function prototypes ***/
+
+int tag_lookup(const char *name, size_t length); /** Finds the TAG_ index of a tag name, TAG_OTHER if it isn't recorded */
+bool tag_pair_read(INPUT *input, TAG_PAIR *pair); /** Reads the tag pair at the cursor, returns false (leaving the cursor) if there isn't one */
+void tags_free(TAGS *tags); /** Frees the values of a tag pair section */
+void tags_read(INPUT *input, TAGS *tags); /** Reads the tag pair section at the cursor, leaving the cursor at the movetext */
+
+#endif
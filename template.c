@@ -0,0 +1,162 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "template.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+
+/* a placeholder tag and the segment it compiles to, a line tag replaces the whole line
+   it is on whereas an inline tag is replaced where it stands */
+typedef struct {
+  const char *tag;
+  SEGMENT_TYPE type;
+  bool inline_tag;
+} PLACEHOLDER;
+
+const PLACEHOLDER placeholders[] = {
+  {"<black/>", SEGMENT_BLACK, false},
+  {"<board/>", SEGMENT_BOARD, false},
+  {"<credit/>", SEGMENT_CREDIT, true},
+  {"<current/>", SEGMENT_CURRENT, false},
+  {"<date/>", SEGMENT_DATE, false},
+  {"<event/>", SEGMENT_EVENT, false},
+  {"<game/>", SEGMENT_GAME, false},
+  {"<gamelist/>", SEGMENT_GAMELIST, false},
+  {"<initial/>", SEGMENT_INITIAL, false},
+  {"<moves/>", SEGMENT_MOVES, false},
+  {"<notation/>", SEGMENT_NOTATION, false},
+  {"<pieces/>", SEGMENT_PIECES, true},
+  {"<result/>", SEGMENT_RESULT, false},
+  {"<round/>", SEGMENT_ROUND, false},
+  {"<site/>", SEGMENT_SITE, false},
+  {"<white/>", SEGMENT_WHITE, false}
+};
+
+#define NO_PLACEHOLDERS (sizeof(placeholders) / sizeof(PLACEHOLDER))
+
+/* function prototypes */
+void add_segment(TEMPLATE *template, int *size, SEGMENT_TYPE type, const char *text, size_t length);
+const PLACEHOLDER *match_placeholder(const char *text, const char *end);
+
+/* reads a template and splits it into literal text and placeholders */
+TEMPLATE *template_compile(const char *filename)
+{
+  TEMPLATE *template;
+  INPUT *file;
+  const char *line, *end, *next, *c;
+  const PLACEHOLDER *placeholder;
+  bool line_tags;
+  int size = 64;
+
+  if((file = input_open(filename)) == NULL) {
+    return NULL;
+  }
+
+  template = (TEMPLATE*)calloc(1, sizeof(TEMPLATE));
+  template->segments = (SEGMENT*)malloc(size * sizeof(SEGMENT));
+  template->file = file;
+
+  for(line = file->data; line < file->data + file->length; line = next) {
+    next = memchr(line, '\n', file->data + file->length - line);
+    next = next ? next + 1 : file->data + file->length;
+
+    /* a line tag stands for the whole line, so any text around it is dropped */
+    line_tags = false;
+    for(c = line; (c = memchr(c, '<', next - c)); c++) {
+      if((placeholder = match_placeholder(c, next)) && !placeholder->inline_tag) {
+	add_segment(template, &size, placeholder->type, NULL, 0);
+	line_tags = true;
+      }
+    }
+
+    if(line_tags) {
+      continue;
+    }
+
+    /* otherwise copy the line, replacing any inline tags */
+    end = line;
+    for(c = line; (c = memchr(c, '<', next - c)); c++) {
+      if((placeholder = match_placeholder(c, next))) {
+	add_segment(template, &size, SEGMENT_LITERAL, end, c - end);
+	add_segment(template, &size, placeholder->type, NULL, 0);
+	end = c + strlen(placeholder->tag);
+	c = end - 1;
+      }
+    }
+
+    add_segment(template, &size, SEGMENT_LITERAL, end, next - end);
+  }
+
+  return template;
+}
+
+/* frees a compiled template */
+void template_free(TEMPLATE *template)
+{
+  input_close(template->file);
+  free((void*)template->segments);
+  free((void*)template);
+}
+
+/* appends a segment, joining literals which follow on from each other */
+void add_segment(TEMPLATE *template, int *size, SEGMENT_TYPE type, const char *text, size_t length)
+{
+  SEGMENT *last = template->count ? &template->segments[template->count - 1] : NULL;
+
+  if(type == SEGMENT_LITERAL) {
+    if(length == 0) {
+      return;
+    }
+    if(last && last->type == SEGMENT_LITERAL && last->text + last->length == text) {
+      last->length += length;
+      return;
+    }
+  }
+
+  if(template->count == *size) {
+    *size *= 2;
+    template->segments = (SEGMENT*)realloc((void*)template->segments, *size * sizeof(SEGMENT));
+  }
+
+  template->segments[template->count].type = type;
+  template->segments[template->count].text = text;
+  template->segments[template->count].length = length;
+  template->count++;
+}
+
+/* returns the placeholder whose tag starts the text, NULL if there is none */
+const PLACEHOLDER *match_placeholder(const char *text, const char *end)
+{
+  unsigned int placeholder;
+  size_t length;
+
+  for(placeholder = 0; placeholder < NO_PLACEHOLDERS; placeholder++) {
+    length = strlen(placeholders[placeholder].tag);
+    if((size_t)(end - text) >= length && !memcmp(text, placeholders[placeholder].tag, length)) {
+      return &placeholders[placeholder];
+    }
+  }
+
+  return NULL;
+}
@@ -0,0 +1,58 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef _TEMPLATE_H_
+#define _TEMPLATE_H_
+
+#include <stddef.h>
+
+#include "input.h"
+
+/* kinds of segment, a literal chunk of text or one of the XML-like placeholder tags */
+typedef enum {
+  SEGMENT_LITERAL,
+  SEGMENT_BLACK, SEGMENT_BOARD, SEGMENT_CREDIT, SEGMENT_CURRENT, SEGMENT_DATE,
+  SEGMENT_EVENT, SEGMENT_GAME, SEGMENT_GAMELIST, SEGMENT_INITIAL, SEGMENT_MOVES,
+  SEGMENT_NOTATION, SEGMENT_PIECES, SEGMENT_RESULT, SEGMENT_ROUND, SEGMENT_SITE,
+  SEGMENT_WHITE
+} SEGMENT_TYPE;
+
+/* a piece of a template, the text is only set for literals */
+typedef struct {
+  SEGMENT_TYPE type;
+  const char *text;
+  size_t length;
+} SEGMENT;
+
+/* a template compiled to a list of segments, to be rendered in order */
+typedef struct {
+  SEGMENT *segments;
+  int count;
+
+  INPUT *file; /* the literals point into the template file */
+} TEMPLATE;
+
+/*** Function prototypes ***/
+
+TEMPLATE *template_compile(const char *filename); /** Reads and compiles a template, NULL if it can't be read */
+void template_free(TEMPLATE *template); /** Frees a compiled template */
+
+#endif
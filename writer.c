@@ -0,0 +1,391 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "writer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* io_uring is optional, build with -DHAVE_IO_URING on linux 5.6 or later to use it.
+   the system calls are made directly so liburing isn't needed */
+#ifdef HAVE_IO_URING
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* files in flight on a ring, each has one operation queued or running at a time
+   so the rings can never fill up */
+#define SLOTS 32
+
+/* longer pages are written in parts, the length of a write is only 32 bits */
+#define MAX_WRITE 0x40000000
+
+/* the operation a completion belongs to is kept in the low bits of its user data,
+   above them is the file's slot */
+#define OPEN  0
+#define WRITE 1
+#define CLOSE 2
+
+/* a file being written */
+typedef struct {
+  char *path; /* NULL if the slot is free */
+  PAGE page;
+  size_t written;
+  int file;
+} SLOT;
+
+struct writer {
+  int ring;
+
+  /* the rings shared with the kernel */
+  void *sq_map, *cq_map;
+  size_t sq_map_size, cq_map_size;
+  unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned int *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe *sqes;
+  size_t sqes_size;
+  struct io_uring_cqe *cqes;
+
+  unsigned int queued; /* submissions not yet passed to the kernel */
+  SLOT slots[SLOTS];
+  int busy;
+  bool failed; /* since the last flush */
+};
+
+/* function prototypes */
+void complete_operation(WRITER *writer, const struct io_uring_cqe *cqe);
+bool enter_ring(WRITER *writer, unsigned int wait);
+void queue_operation(WRITER *writer, int index, int operation);
+void release_slot(WRITER *writer, int index);
+bool supported(int ring);
+
+/* sets up a writer, NULL if io_uring or the operations it needs aren't available */
+WRITER *writer_create(void)
+{
+  WRITER *writer;
+  struct io_uring_params params;
+  int ring;
+
+  memset(&params, 0, sizeof(params));
+
+  if((ring = syscall(__NR_io_uring_setup, SLOTS, &params)) < 0) {
+    return NULL;
+  }
+
+  if(!supported(ring)) {
+    close(ring);
+    return NULL;
+  }
+
+  writer = (WRITER*)calloc(1, sizeof(WRITER));
+  writer->ring = ring;
+
+  /* map the submission and completion rings, which newer kernels put in one mapping */
+  writer->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  writer->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+  if(params.features & IORING_FEAT_SINGLE_MMAP) {
+    if(writer->cq_map_size > writer->sq_map_size) {
+      writer->sq_map_size = writer->cq_map_size;
+    }
+    writer->cq_map_size = 0;
+  }
+
+  writer->sq_map = mmap(NULL, writer->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			ring, IORING_OFF_SQ_RING);
+  writer->cq_map = writer->cq_map_size ?
+    mmap(NULL, writer->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING) :
+    writer->sq_map;
+  writer->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  writer->sqes = (struct io_uring_sqe*)mmap(NULL, writer->sqes_size, PROT_READ | PROT_WRITE,
+					    MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+
+  if(writer->sq_map == MAP_FAILED || writer->cq_map == MAP_FAILED || writer->sqes == MAP_FAILED) {
+    writer_free(writer);
+    return NULL;
+  }
+
+  writer->sq_head = (unsigned int*)((char*)writer->sq_map + params.sq_off.head);
+  writer->sq_tail = (unsigned int*)((char*)writer->sq_map + params.sq_off.tail);
+  writer->sq_mask = (unsigned int*)((char*)writer->sq_map + params.sq_off.ring_mask);
+  writer->sq_array = (unsigned int*)((char*)writer->sq_map + params.sq_off.array);
+  writer->cq_head = (unsigned int*)((char*)writer->cq_map + params.cq_off.head);
+  writer->cq_tail = (unsigned int*)((char*)writer->cq_map + params.cq_off.tail);
+  writer->cq_mask = (unsigned int*)((char*)writer->cq_map + params.cq_off.ring_mask);
+  writer->cqes = (struct io_uring_cqe*)((char*)writer->cq_map + params.cq_off.cqes);
+
+  return writer;
+}
+
+/* waits until every queued page is written */
+bool writer_flush(WRITER *writer)
+{
+  bool written;
+
+  while(writer->busy > 0 && enter_ring(writer, 1)) {
+  }
+
+  written = !writer->failed && writer->busy == 0;
+  writer->failed = false;
+
+  return written;
+}
+
+/* flushes and frees a writer */
+void writer_free(WRITER *writer)
+{
+  int slot;
+
+  if(writer->sqes && writer->sqes != MAP_FAILED) {
+    writer_flush(writer);
+    munmap((void*)writer->sqes, writer->sqes_size);
+  }
+
+  /* only left if the ring failed */
+  for(slot = 0; slot < SLOTS; slot++) {
+    if(writer->slots[slot].path) {
+      release_slot(writer, slot);
+    }
+  }
+
+  if(writer->cq_map && writer->cq_map != MAP_FAILED && writer->cq_map != writer->sq_map) {
+    munmap(writer->cq_map, writer->cq_map_size);
+  }
+  if(writer->sq_map && writer->sq_map != MAP_FAILED) {
+    munmap(writer->sq_map, writer->sq_map_size);
+  }
+
+  close(writer->ring);
+  free((void*)writer);
+}
+
+/* queues the page to be written to filename followed by suffix, the writer takes the
+   page's text and frees it once written */
+void writer_queue(WRITER *writer, const char *filename, const char *suffix, PAGE *page)
+{
+  SLOT *slot;
+  int index;
+
+  /* wait for a file to finish if they are all in flight */
+  while(writer->busy == SLOTS && enter_ring(writer, 1)) {
+  }
+
+  if(writer->busy == SLOTS) {
+    writer->failed = true;
+    page_free(page);
+    page->data = NULL;
+    return;
+  }
+
+  for(index = 0; writer->slots[index].path; index++) {
+  }
+
+  slot = &writer->slots[index];
+  slot->path = (char*)calloc(strlen(filename) + strlen(suffix) + 1, sizeof(char));
+  strcpy(slot->path, filename);
+  strcat(slot->path, suffix);
+  slot->page = *page;
+  slot->written = 0;
+  page->data = NULL;
+  writer->busy++;
+
+  queue_operation(writer, index, OPEN);
+
+  /* pass the opens to the kernel a few at a time, collecting whatever has finished */
+  if(writer->queued >= SLOTS / 4) {
+    enter_ring(writer, 0);
+  }
+}
+
+/* moves a file on to its next operation once one completes */
+void complete_operation(WRITER *writer, const struct io_uring_cqe *cqe)
+{
+  int index = (int)(cqe->user_data >> 2);
+  SLOT *slot = &writer->slots[index];
+
+  switch(cqe->user_data & 3) {
+  case OPEN:
+    if(cqe->res < 0) {
+      writer->failed = true;
+      release_slot(writer, index);
+      return;
+    }
+    slot->file = cqe->res;
+    break;
+
+  case WRITE:
+    if(cqe->res <= 0) {
+      /* give up on the rest, but still close the file */
+      writer->failed = true;
+      slot->written = slot->page.length;
+    }
+    else {
+      slot->written += cqe->res;
+    }
+    break;
+
+  case CLOSE:
+    if(cqe->res < 0) {
+      writer->failed = true;
+    }
+    release_slot(writer, index);
+    return;
+  }
+
+  queue_operation(writer, index, (slot->written < slot->page.length) ? WRITE : CLOSE);
+}
+
+/* submits the queued operations, waits for at least wait of them to complete and
+   handles the completions. false if the ring has failed */
+bool enter_ring(WRITER *writer, unsigned int wait)
+{
+  unsigned int head, tail;
+  int result;
+
+  do {
+    result = syscall(__NR_io_uring_enter, writer->ring, writer->queued, wait,
+		     wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+  } while(result < 0 && errno == EINTR);
+
+  if(result < 0) {
+    writer->failed = true;
+    return false;
+  }
+
+  writer->queued -= result;
+
+  /* the kernel adds completions at the tail, and they are taken from the head */
+  head = *writer->cq_head;
+  tail = __atomic_load_n(writer->cq_tail, __ATOMIC_ACQUIRE);
+
+  for(; head != tail; head++) {
+    complete_operation(writer, &writer->cqes[head & *writer->cq_mask]);
+  }
+
+  __atomic_store_n(writer->cq_head, head, __ATOMIC_RELEASE);
+
+  return true;
+}
+
+/* adds a file's next operation to the submission ring */
+void queue_operation(WRITER *writer, int index, int operation)
+{
+  SLOT *slot = &writer->slots[index];
+  struct io_uring_sqe *sqe;
+  unsigned int tail, entry;
+  size_t length;
+
+  tail = *writer->sq_tail;
+  entry = tail & *writer->sq_mask;
+  sqe = &writer->sqes[entry];
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+  switch(operation) {
+  case OPEN:
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (unsigned long)slot->path;
+    sqe->len = 0666;
+    sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+    break;
+
+  case WRITE:
+    length = slot->page.length - slot->written;
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = slot->file;
+    sqe->addr = (unsigned long)(slot->page.data + slot->written);
+    sqe->len = (length > MAX_WRITE) ? MAX_WRITE : length;
+    sqe->off = slot->written;
+    break;
+
+  case CLOSE:
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = slot->file;
+    break;
+  }
+
+  sqe->user_data = ((unsigned long long)index << 2) | operation;
+
+  /* the entry must be complete before the kernel can see the new tail */
+  writer->sq_array[entry] = entry;
+  __atomic_store_n(writer->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  writer->queued++;
+}
+
+/* frees a file's slot once it is finished with */
+void release_slot(WRITER *writer, int index)
+{
+  SLOT *slot = &writer->slots[index];
+
+  free((void*)slot->path);
+  page_free(&slot->page);
+  slot->path = NULL;
+  writer->busy--;
+}
+
+/* checks the kernel supports the operations used, they came in after io_uring itself */
+bool supported(int ring)
+{
+  struct io_uring_probe *probe;
+  int operations[3] = {IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE};
+  int operation;
+  bool result;
+
+  probe = (struct io_uring_probe*)calloc(1, sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+
+  result = (syscall(__NR_io_uring_register, ring, IORING_REGISTER_PROBE, probe, 256) == 0);
+
+  for(operation = 0; result && operation < 3; operation++) {
+    result = (operations[operation] <= probe->last_op &&
+	      (probe->ops[operations[operation]].flags & IO_URING_OP_SUPPORTED));
+  }
+
+  free((void*)probe);
+
+  return result;
+}
+
+#else
+
+/* without io_uring there is no writer and the pages are saved directly */
+WRITER *writer_create(void)
+{
+  return NULL;
+}
+
+bool writer_flush(WRITER *writer)
+{
+  return true;
+}
+
+void writer_free(WRITER *writer)
+{
+}
+
+void writer_queue(WRITER *writer, const char *filename, const char *suffix, PAGE *page)
+{
+}
+
+#endif
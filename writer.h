@@ -0,0 +1,39 @@
+/*
+  pgn2web - Converts PGN files to interactive web pages
+
+  Copyright (C) 2004-2009 William Hoggarth <email: whoggarth@users.sourceforge.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef _WRITER_H_
+#define _WRITER_H_
+
+#include "bool.h"
+#include "page.h"
+
+/* writes pages through a linux io_uring, many files being opened, written and closed
+   at once with few system calls. a writer is used by one thread at a time */
+typedef struct writer WRITER;
+
+/*** Function prototypes ***/
+
+WRITER *writer_create(void); /** Sets up a writer, NULL if io_uring isn't available so the pages must be saved directly */
+bool writer_flush(WRITER *writer); /** Waits until every queued page is written, false if any couldn't be */
+void writer_free(WRITER *writer); /** Flushes and frees a writer */
+void writer_queue(WRITER *writer, const char *filename, const char *suffix, PAGE *page); /** Queues the page to be written to filename followed by suffix, taking its text */
+
+#endif